@@ -0,0 +1,481 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   fsm-bench-run
+   ^^^^^^^^^^^^^
+   One measurement of the FSM workload, launched under mpirun (usually by fsm-bench).
+   ROOT sends batches of RANDOM symbols to every non-root process, every non-root
+   process steps its FSM over each symbol of each batch, and the run ends once every
+   non-root process has been handed its share of symbols.  Unlike the examples, a
+   non-root process that reaches its final state starts over from the start state,
+   so that it keeps doing real work until the end.
+
+   usage: fsm-bench-run [-s strategy] [-b batch] [-m payload bytes] [-n symbols]
+
+    -s  how a batch gets from ROOT to the non-root processes
+          send        ROOT does one blocking MPI_Send per node, as in the examples
+          bcast       MPI_Bcast
+          ibcast      MPI_Ibcast, the next batch is on its way while a node steps
+          isend       ROOT keeps a pool of _POOL_DEPTH batches in flight with MPI_Isend
+          persistent  MPI_Send_init/MPI_Recv_init once, MPI_Start* every batch; nodes
+                      have the next receive posted while they step
+          rma         ROOT MPI_Puts into a window on every node (post/start/complete/
+                      wait), the next epoch is open while a node steps
+          shm         ROOT writes into an MPI_Win_allocate_shared window that the nodes
+                      read in place, one barrier per batch; only the batch is written,
+                      so the ballast costs nothing; needs all ranks on one host
+          chain       each node forwards to the next (0 -> 1 -> ... -> num_nodes-1)
+          tree        each node forwards to its children in a binary tree
+          all         every strategy above, one after the other, one row each (shm
+                      is left out if the ranks do not share a host)
+    -b  symbols per batch (message)
+    -m  message size in bytes; at least big enough to hold the batch, the rest is
+        ballast
+    -n  symbols each non-root process steps over (rounded up to whole batches)
+
+   Output is one CSV row per strategy, with the columns
+
+     strategy,ranks,batch,payload_bytes,symbols_per_node,elapsed_s,symbols_per_s,
+     bytes_per_s,time_to_all_final_s,cpu_root_s,cpu_node_min_s,cpu_node_mean_s,
+     cpu_node_max_s,root_cpu_util,node_idle_min,node_idle_mean,node_idle_max,
+     cpu_per_rank_s
+
+   where root_cpu_util is ROOT's CPU time over the elapsed time, node_idle_* is the
+   share of the elapsed time a non-root process spent blocked in MPI waiting for its
+   next batch (or for its forwards to drain), cpu_per_rank_s is the CPU time of every
+   rank in rank order, ';' separated, and time_to_all_final_s is nan if some node
+   never reached its final state.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "mpi.h"
+#define _ROOT 0;                // root node
+#define _BATCH_SIZE 16;         // default symbols per batch
+#define _MSG_BYTES 400;         // default message size
+#define _NUM_SYMBOLS 100000;    // default symbols per non-root process
+#define _POOL_DEPTH 4;          // batches ROOT may have in flight with isend
+#define NUM_BUFFERS 2           // batches a node holds with ibcast, persistent, rma and shm
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A =  0,
+  B =  1,
+  C =  2,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+// enum dissemination strategies
+enum {
+  SEND       = 0,
+  BCAST      = 1,
+  CHAIN      = 2,
+  TREE       = 3,
+  IBCAST     = 4,
+  ISEND      = 5,
+  PERSISTENT = 6,
+  RMA        = 7,
+  SHM        = 8,
+  NUM_STRATEGIES,
+  ALL = NUM_STRATEGIES
+};
+const char *STRATEGY_NAMES[NUM_STRATEGIES+1] = {"send","bcast","chain","tree","ibcast","isend",
+                                                "persistent","rma","shm","all"};
+// the order -s all runs them in
+const int ALL_STRATEGIES[NUM_STRATEGIES] = {SEND,BCAST,IBCAST,ISEND,PERSISTENT,RMA,SHM,CHAIN,TREE};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   The same machine as in the examples: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+double get_cpu_time (void) {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF,&ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec)/1.0e6;
+}
+
+// fills children with the ranks rank forwards to, returns how many there are
+int get_children (int rank, int strategy, int num_nodes, int *children) {
+  int n = 0;
+  if (CHAIN == strategy) {
+    if (rank+1 < num_nodes) children[n++] = rank+1;
+  } else if (TREE == strategy) {
+    if (2*rank+1 < num_nodes) children[n++] = 2*rank+1;
+    if (2*rank+2 < num_nodes) children[n++] = 2*rank+2;
+  }
+  return n;
+}
+
+/*
+   Measurement
+   ^^^^^^^^^^^
+   Everything a strategy needs (requests, windows, groups) is set up before the clock
+   starts and torn down after it stops.  idle accumulates the time a non-root process
+   spends blocked in MPI.
+*/
+
+int ROOT, my_rank, num_nodes, my_state;
+int BATCH_SIZE, POOL_DEPTH;
+long msg_size, num_rounds;
+double t_start, t_final, idle;
+
+void fill_batch (int *batch) {
+  int i;
+  for (i=0;i<BATCH_SIZE;i++) batch[i] = get_random_msg();
+}
+
+void step_batch (const int *batch) {
+  int i;
+  for (i=0;i<BATCH_SIZE;i++) {
+    switch (batch[i]) {
+      case A: if (Q0 == my_state) my_state = next_state_proc(my_state,batch[i]); break;
+      case B: if (Q1 == my_state) my_state = next_state_proc(my_state,batch[i]); break;
+      case C: if (Q2 == my_state) my_state = next_state_proc(my_state,batch[i]); break;
+    }
+    if (Q3 == my_state) {
+      if (t_final < 0.0)
+          t_final = MPI_Wtime() - t_start;
+      my_state = Q0; // start the next session
+    }
+  }
+}
+
+void wait_idle (int count, MPI_Request *reqs) {
+  double t = MPI_Wtime();
+  MPI_Waitall(count,reqs,MPI_STATUSES_IGNORE);
+  idle += MPI_Wtime() - t;
+}
+
+void measure (int strategy, MPI_Comm shm_comm) {
+  int j,cur,nxt,slot,parent,num_children,children[2];
+  int num_reqs = (ROOT == my_rank) ? POOL_DEPTH*(num_nodes-1) : NUM_BUFFERS;
+  long round;
+  double t,elapsed,cpu,all_final;
+  int *batch;
+  MPI_Request reqs[2];
+  MPI_Request *pool = malloc(num_reqs*sizeof(MPI_Request));
+  MPI_Group world_group, root_group, node_group;
+  MPI_Win win = MPI_WIN_NULL;
+  MPI_Aint shm_size;
+  int shm_disp;
+  int *shm = NULL;
+
+  // POOL_DEPTH batches back to back; only isend uses more than NUM_BUFFERS of them
+  int *buf = malloc(POOL_DEPTH*msg_size*sizeof(int));
+  if (NULL == buf || NULL == pool) {
+    fprintf(stderr,"Node %d could not allocate %d %ld byte messages\n",my_rank,POOL_DEPTH,msg_size*(long)sizeof(int));
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  memset(buf,0xff,POOL_DEPTH*msg_size*sizeof(int));
+  for (j=0;j<num_reqs;j++) pool[j] = MPI_REQUEST_NULL;
+  parent = (CHAIN == strategy) ? my_rank-1 : (my_rank-1)/2;
+  num_children = get_children(my_rank,strategy,num_nodes,children);
+  my_state = (ROOT == my_rank) ? R0 : Q0;
+  t_final = -1.0;
+  idle = 0.0;
+  srand(1); // every strategy gets the same symbols
+
+  MPI_Comm_group(MPI_COMM_WORLD,&world_group);
+  MPI_Group_incl(world_group,1,&ROOT,&root_group);
+  MPI_Group_excl(world_group,1,&ROOT,&node_group);
+  switch (strategy) {
+    case PERSISTENT:
+      for (cur=0;cur<NUM_BUFFERS;cur++) {
+        if (ROOT == my_rank) {
+          for (j=1;j<num_nodes;j++)
+              MPI_Send_init(buf+cur*msg_size,msg_size,MPI_INT,j,0,MPI_COMM_WORLD,&pool[cur*(num_nodes-1)+j-1]);
+        } else {
+          MPI_Recv_init(buf+cur*msg_size,msg_size,MPI_INT,ROOT,0,MPI_COMM_WORLD,&pool[cur]);
+        }
+      }
+      break;
+    case RMA:
+      MPI_Win_create(buf,(ROOT == my_rank) ? 0 : NUM_BUFFERS*msg_size*sizeof(int),sizeof(int),
+                     MPI_INFO_NULL,MPI_COMM_WORLD,&win);
+      break;
+    case SHM:
+      MPI_Win_allocate_shared((ROOT == my_rank) ? NUM_BUFFERS*msg_size*sizeof(int) : 0,sizeof(int),
+                              MPI_INFO_NULL,shm_comm,&shm,&win);
+      MPI_Win_shared_query(win,ROOT,&shm_size,&shm_disp,&shm);
+      if (ROOT == my_rank)
+          memset(shm,0xff,NUM_BUFFERS*msg_size*sizeof(int));
+      MPI_Win_lock_all(MPI_MODE_NOCHECK,win);
+      break;
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t_start = MPI_Wtime();
+  cpu = get_cpu_time();
+  for (round=0;round<num_rounds;round++) {
+    cur = round % NUM_BUFFERS;
+    nxt = (round+1) % NUM_BUFFERS;
+    batch = buf;
+    switch (strategy) {
+      case SEND:
+        if (ROOT == my_rank) {
+          fill_batch(batch);
+          for (j=1;j<num_nodes;j++)
+              MPI_Send(batch,msg_size,MPI_INT,j,0,MPI_COMM_WORLD);
+        } else {
+          t = MPI_Wtime();
+          MPI_Recv(batch,msg_size,MPI_INT,ROOT,0,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+          idle += MPI_Wtime() - t;
+        }
+        break;
+      case BCAST:
+        if (ROOT == my_rank)
+            fill_batch(batch);
+        t = MPI_Wtime();
+        MPI_Bcast(batch,msg_size,MPI_INT,ROOT,MPI_COMM_WORLD);
+        idle += MPI_Wtime() - t;
+        break;
+      case IBCAST:
+        // this round's batch went out with the previous round, send the next one before waiting
+        if (0 == round) {
+          if (ROOT == my_rank)
+              fill_batch(buf);
+          MPI_Ibcast(buf,msg_size,MPI_INT,ROOT,MPI_COMM_WORLD,&reqs[0]);
+        }
+        if (round+1 < num_rounds) {
+          if (ROOT == my_rank)
+              fill_batch(buf+nxt*msg_size);
+          MPI_Ibcast(buf+nxt*msg_size,msg_size,MPI_INT,ROOT,MPI_COMM_WORLD,&reqs[nxt]);
+        }
+        wait_idle(1,&reqs[cur]);
+        batch = buf+cur*msg_size;
+        break;
+      case ISEND:
+        if (ROOT == my_rank) {
+          // reuse the oldest batch of the pool once all its sends are done
+          slot = round % POOL_DEPTH;
+          batch = buf+slot*msg_size;
+          MPI_Waitall(num_nodes-1,&pool[slot*(num_nodes-1)],MPI_STATUSES_IGNORE);
+          fill_batch(batch);
+          for (j=1;j<num_nodes;j++)
+              MPI_Isend(batch,msg_size,MPI_INT,j,0,MPI_COMM_WORLD,&pool[slot*(num_nodes-1)+j-1]);
+        } else {
+          t = MPI_Wtime();
+          MPI_Recv(batch,msg_size,MPI_INT,ROOT,0,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+          idle += MPI_Wtime() - t;
+        }
+        break;
+      case PERSISTENT:
+        if (ROOT == my_rank) {
+          batch = buf+cur*msg_size;
+          MPI_Waitall(num_nodes-1,&pool[cur*(num_nodes-1)],MPI_STATUSES_IGNORE); // inactive the first time round
+          fill_batch(batch);
+          MPI_Startall(num_nodes-1,&pool[cur*(num_nodes-1)]);
+        } else {
+          if (0 == round)
+              MPI_Start(&pool[cur]);
+          if (round+1 < num_rounds)
+              MPI_Start(&pool[nxt]);
+          wait_idle(1,&pool[cur]);
+          batch = buf+cur*msg_size;
+        }
+        break;
+      case RMA:
+        if (ROOT == my_rank) {
+          fill_batch(batch);
+          MPI_Win_start(node_group,0,win);
+          for (j=1;j<num_nodes;j++)
+              MPI_Put(batch,msg_size,MPI_INT,j,cur*msg_size,msg_size,MPI_INT,win);
+          MPI_Win_complete(win);
+        } else {
+          if (0 == round)
+              MPI_Win_post(root_group,0,win);
+          t = MPI_Wtime();
+          MPI_Win_wait(win);
+          idle += MPI_Wtime() - t;
+          if (round+1 < num_rounds)
+              MPI_Win_post(root_group,0,win); // ROOT only writes the other buffer
+          batch = buf+cur*msg_size;
+        }
+        break;
+      case SHM:
+        // a node has stepped over the previous batch in the other buffer before it
+        // reaches the barrier, so ROOT never writes over a batch that is being read
+        batch = shm+cur*msg_size;
+        if (ROOT == my_rank) {
+          fill_batch(batch);
+          MPI_Win_sync(win);
+          MPI_Barrier(shm_comm);
+        } else {
+          t = MPI_Wtime();
+          MPI_Barrier(shm_comm);
+          idle += MPI_Wtime() - t;
+          MPI_Win_sync(win);
+        }
+        break;
+      case CHAIN:
+      case TREE:
+        if (ROOT == my_rank) {
+          fill_batch(batch);
+        } else {
+          t = MPI_Wtime();
+          MPI_Recv(batch,msg_size,MPI_INT,parent,0,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+          idle += MPI_Wtime() - t;
+        }
+        for (j=0;j<num_children;j++)
+            MPI_Isend(batch,msg_size,MPI_INT,children[j],0,MPI_COMM_WORLD,&reqs[j]);
+        break;
+    }
+    if (ROOT != my_rank)
+        step_batch(batch);
+    if (num_children > 0)
+        wait_idle(num_children,reqs); // batch is about to be overwritten
+  }
+  if (ROOT == my_rank && (ISEND == strategy || PERSISTENT == strategy))
+      MPI_Waitall(num_reqs,pool,MPI_STATUSES_IGNORE);
+  elapsed = MPI_Wtime() - t_start;
+  cpu = get_cpu_time() - cpu;
+
+  switch (strategy) {
+    case PERSISTENT:
+      for (j=0;j<num_reqs;j++)
+          if (MPI_REQUEST_NULL != pool[j])
+              MPI_Request_free(&pool[j]);
+      break;
+    case RMA:
+      MPI_Win_free(&win);
+      break;
+    case SHM:
+      MPI_Win_unlock_all(win);
+      MPI_Win_free(&win);
+      break;
+  }
+  MPI_Group_free(&node_group);
+  MPI_Group_free(&root_group);
+  MPI_Group_free(&world_group);
+
+  // ROOT has no final state; a node that never got there poisons the max
+  if (ROOT == my_rank)
+      t_final = 0.0;
+  else if (t_final < 0.0)
+      t_final = 1.0e300;
+  double max_elapsed;
+  double *cpus = (ROOT == my_rank) ? malloc(num_nodes*sizeof(double)) : NULL;
+  double *idles = (ROOT == my_rank) ? malloc(num_nodes*sizeof(double)) : NULL;
+  MPI_Reduce(&elapsed,&max_elapsed,1,MPI_DOUBLE,MPI_MAX,ROOT,MPI_COMM_WORLD);
+  MPI_Reduce(&t_final,&all_final,1,MPI_DOUBLE,MPI_MAX,ROOT,MPI_COMM_WORLD);
+  MPI_Gather(&cpu,1,MPI_DOUBLE,cpus,1,MPI_DOUBLE,ROOT,MPI_COMM_WORLD);
+  idle = (elapsed > 0.0) ? idle/elapsed : 0.0;
+  MPI_Gather(&idle,1,MPI_DOUBLE,idles,1,MPI_DOUBLE,ROOT,MPI_COMM_WORLD);
+
+  if (ROOT == my_rank) {
+    double cpu_min=cpus[1],cpu_max=cpus[1],cpu_sum=0.0;
+    double idle_min=idles[1],idle_max=idles[1],idle_sum=0.0;
+    double symbols = (double)num_rounds*BATCH_SIZE*(num_nodes-1);
+    double bytes = (double)num_rounds*msg_size*sizeof(int)*(num_nodes-1);
+    for (j=1;j<num_nodes;j++) {
+      if (cpus[j] < cpu_min) cpu_min = cpus[j];
+      if (cpus[j] > cpu_max) cpu_max = cpus[j];
+      cpu_sum += cpus[j];
+      if (idles[j] < idle_min) idle_min = idles[j];
+      if (idles[j] > idle_max) idle_max = idles[j];
+      idle_sum += idles[j];
+    }
+    printf("%s,%d,%d,%ld,%ld,%.6f,%.1f,%.1f,",STRATEGY_NAMES[strategy],num_nodes,BATCH_SIZE,
+           msg_size*(long)sizeof(int),num_rounds*BATCH_SIZE,max_elapsed,symbols/max_elapsed,bytes/max_elapsed);
+    if (all_final < 1.0e300)
+        printf("%.6f,",all_final);
+    else
+        printf("nan,");
+    printf("%.6f,%.6f,%.6f,%.6f,",cpus[0],cpu_min,cpu_sum/(num_nodes-1),cpu_max);
+    printf("%.4f,%.4f,%.4f,%.4f,",(elapsed > 0.0) ? cpus[0]/elapsed : 0.0,idle_min,idle_sum/(num_nodes-1),idle_max);
+    for (j=0;j<num_nodes;j++)
+        printf("%s%.6f",(j) ? ";" : "",cpus[j]);
+    printf("\n");
+    fflush(stdout);
+    free(idles);
+    free(cpus);
+  }
+
+  free(pool);
+  free(buf);
+}
+
+int main(int argc, char** argv) {
+  long MSG_BYTES=_MSG_BYTES;
+  long SYMBOLS=_NUM_SYMBOLS;
+  int STRATEGY=SEND;
+  int s,opt,shm_size;
+  MPI_Comm shm_comm;
+
+  ROOT=_ROOT;
+  BATCH_SIZE=_BATCH_SIZE;
+  POOL_DEPTH=_POOL_DEPTH;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_split_type(MPI_COMM_WORLD,MPI_COMM_TYPE_SHARED,0,MPI_INFO_NULL,&shm_comm);
+  MPI_Comm_size(shm_comm,&shm_size);
+
+  while (-1 != (opt = getopt(argc,argv,"s:b:m:n:"))) {
+    switch (opt) {
+      case 's':
+        for (STRATEGY=0;STRATEGY<=ALL;STRATEGY++)
+            if (0 == strcmp(optarg,STRATEGY_NAMES[STRATEGY]))
+                break;
+        break;
+      case 'b': BATCH_SIZE = atoi(optarg); break;
+      case 'm': MSG_BYTES = atol(optarg); break;
+      case 'n': SYMBOLS = atol(optarg); break;
+    }
+  }
+  if (STRATEGY > ALL || BATCH_SIZE < 1 || SYMBOLS < 1 || num_nodes < 2 || (SHM == STRATEGY && shm_size != num_nodes)) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [-s send|bcast|ibcast|isend|persistent|rma|shm|chain|tree|all] [-b batch] "
+                       "[-m payload bytes] [-n symbols], with 2 or more ranks (shm: all on one host)\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+  msg_size = MSG_BYTES/(long)sizeof(int);
+  if (msg_size < BATCH_SIZE) msg_size = BATCH_SIZE;
+  num_rounds = (SYMBOLS + BATCH_SIZE - 1) / BATCH_SIZE;
+
+  if (ALL != STRATEGY) {
+    measure(STRATEGY,shm_comm);
+  } else {
+    for (s=0;s<NUM_STRATEGIES;s++) {
+      if (SHM == ALL_STRATEGIES[s] && shm_size != num_nodes) {
+        if (ROOT == my_rank)
+            fprintf(stderr,"skipping shm, the ranks are spread over more than one host\n");
+        continue;
+      }
+      measure(ALL_STRATEGIES[s],shm_comm);
+    }
+  }
+
+  MPI_Comm_free(&shm_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,156 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   fsm-bench
+   ^^^^^^^^^
+   Scaling sweep over the FSM workload.  For every combination of scaling mode, rank
+   count, dissemination strategy, batch size and payload size, fsm-bench launches one
+   fsm-bench-run under a local mpirun and collects its CSV row; the whole sweep is
+   written to stdout as CSV with a header.
+
+   usage: fsm-bench [-M modes] [-r ranks] [-s strategies] [-b batches] [-m payloads]
+                    [-n symbols per node] [-N total symbols] [-x fsm-bench-run]
+
+    -M  scaling modes, any of
+          weak    every non-root process steps over -n symbols, whatever the rank count
+          strong  the non-root processes share -N symbols between them
+    -r  rank counts (including ROOT)
+    -s  strategies understood by fsm-bench-run; the default, all, has one
+        fsm-bench-run measure every strategy back to back
+    -b  symbols per batch
+    -m  message sizes in bytes
+    -x  path of fsm-bench-run, by default next to fsm-bench
+
+   All lists are comma separated.  mpirun is taken from $MPIRUN, and $MPIRUN_FLAGS is
+   passed to it as is (e.g. "--oversubscribe" when there are more ranks than cores).
+   The columns are "mode" followed by those of fsm-bench-run.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#define _MODES "strong,weak"
+#define _RANKS "2,3,5,9"
+#define _STRATEGIES "all"
+#define _BATCHES "1,64"
+#define _PAYLOADS "400,65536"
+#define _NODE_SYMBOLS 100000;     // per non-root process, weak scaling
+#define _TOTAL_SYMBOLS 400000;    // over all non-root processes, strong scaling
+#define MAX_LIST 32
+#define MAX_LINE 4096
+
+const char *HEADER = "mode,strategy,ranks,batch,payload_bytes,symbols_per_node,elapsed_s,symbols_per_s,"
+                     "bytes_per_s,time_to_all_final_s,cpu_root_s,cpu_node_min_s,cpu_node_mean_s,"
+                     "cpu_node_max_s,root_cpu_util,node_idle_min,node_idle_mean,node_idle_max,cpu_per_rank_s";
+
+// a CSV row of fsm-bench-run has one column less than HEADER (no mode)
+int is_row (const char *line, const char *strategy) {
+  int commas = 0;
+  const char *c;
+  for (c=HEADER;*c;c++) commas -= (',' == *c);
+  for (c=line;*c;c++) commas += (',' == *c);
+  if (-1 != commas)
+      return 0;
+  return 0 == strcmp(strategy,"all") || (0 == strncmp(line,strategy,strlen(strategy)) && ',' == line[strlen(strategy)]);
+}
+
+// splits the comma separated list in place, returns the number of items
+int split_list (char *list, char **items) {
+  int n = 0;
+  char *item = strtok(list,",");
+  while (NULL != item && n < MAX_LIST) {
+    items[n++] = item;
+    item = strtok(NULL,",");
+  }
+  return n;
+}
+
+// runs one measurement and copies its CSV row to stdout, returns 0 on success
+int run_one (const char *runner, const char *mode, int ranks, const char *strategy,
+             const char *batch, const char *payload, long symbols) {
+  char cmd[MAX_LINE], line[MAX_LINE];
+  const char *mpirun = getenv("MPIRUN");
+  const char *flags = getenv("MPIRUN_FLAGS");
+  int found = 0;
+  FILE *out;
+
+  snprintf(cmd,sizeof(cmd),"%s %s -np %d %s -s %s -b %s -m %s -n %ld",
+           (NULL != mpirun) ? mpirun : "mpirun",(NULL != flags) ? flags : "",
+           ranks,runner,strategy,batch,payload,symbols);
+  if (NULL == (out = popen(cmd,"r"))) {
+    perror(cmd);
+    return -1;
+  }
+  while (NULL != fgets(line,sizeof(line),out)) {
+    if (!is_row(line,strategy))
+        continue; // only the CSV row, not whatever else mpirun has to say
+    printf("%s,%s",mode,line);
+    fflush(stdout);
+    found = 1;
+  }
+  if (0 != pclose(out) || !found) {
+    fprintf(stderr,"failed: %s\n",cmd);
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  char modes_list[MAX_LINE] = _MODES;
+  char ranks_list[MAX_LINE] = _RANKS;
+  char strategies_list[MAX_LINE] = _STRATEGIES;
+  char batches_list[MAX_LINE] = _BATCHES;
+  char payloads_list[MAX_LINE] = _PAYLOADS;
+  char runner[MAX_LINE];
+  long NODE_SYMBOLS=_NODE_SYMBOLS;
+  long TOTAL_SYMBOLS=_TOTAL_SYMBOLS;
+  char *modes[MAX_LIST], *ranks[MAX_LIST], *strategies[MAX_LIST], *batches[MAX_LIST], *payloads[MAX_LIST];
+  int num_modes,num_ranks,num_strategies,num_batches,num_payloads;
+  int mo,r,s,b,p,opt,num_nodes,failures=0;
+  long symbols;
+  char *slash;
+
+  // fsm-bench-run is expected to live next to fsm-bench
+  slash = strrchr(argv[0],'/');
+  snprintf(runner,sizeof(runner),"%.*sfsm-bench-run",(NULL != slash) ? (int)(slash-argv[0]+1) : 2,
+           (NULL != slash) ? argv[0] : "./");
+
+  while (-1 != (opt = getopt(argc,argv,"M:r:s:b:m:n:N:x:"))) {
+    switch (opt) {
+      case 'M': snprintf(modes_list,sizeof(modes_list),"%s",optarg); break;
+      case 'r': snprintf(ranks_list,sizeof(ranks_list),"%s",optarg); break;
+      case 's': snprintf(strategies_list,sizeof(strategies_list),"%s",optarg); break;
+      case 'b': snprintf(batches_list,sizeof(batches_list),"%s",optarg); break;
+      case 'm': snprintf(payloads_list,sizeof(payloads_list),"%s",optarg); break;
+      case 'n': NODE_SYMBOLS = atol(optarg); break;
+      case 'N': TOTAL_SYMBOLS = atol(optarg); break;
+      case 'x': snprintf(runner,sizeof(runner),"%s",optarg); break;
+      default:
+        fprintf(stderr,"usage: %s [-M modes] [-r ranks] [-s strategies] [-b batches] [-m payloads] "
+                       "[-n symbols per node] [-N total symbols] [-x fsm-bench-run]\n",argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+  num_modes = split_list(modes_list,modes);
+  num_ranks = split_list(ranks_list,ranks);
+  num_strategies = split_list(strategies_list,strategies);
+  num_batches = split_list(batches_list,batches);
+  num_payloads = split_list(payloads_list,payloads);
+
+  printf("%s\n",HEADER);
+  for (mo=0;mo<num_modes;mo++)
+    for (r=0;r<num_ranks;r++) {
+      num_nodes = atoi(ranks[r]);
+      if (num_nodes < 2)
+          continue; // need ROOT and at least one node
+      symbols = (0 == strcmp(modes[mo],"strong")) ? (TOTAL_SYMBOLS + num_nodes - 2)/(num_nodes-1) : NODE_SYMBOLS;
+      for (s=0;s<num_strategies;s++)
+        for (b=0;b<num_batches;b++)
+          for (p=0;p<num_payloads;p++)
+              if (0 != run_one(runner,modes[mo],num_nodes,strategies[s],batches[b],payloads[p],symbols))
+                  ++failures;
+    }
+
+  exit((failures) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
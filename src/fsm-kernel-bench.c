@@ -0,0 +1,420 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   fsm-kernel-bench
+   ^^^^^^^^^^^^^^^^
+   Microbenchmark of the transition kernel alone, without MPI.  The non-root process
+   loop of the examples (precondition switch + next_state_proc) and a number of
+   alternative step engines are run over the same synthetic stream of symbols, and
+   the time per symbol is reported.  As in fsm-bench-run, an instance that reaches
+   its final state counts it and starts over, so that every engine does the same
+   work and returns the same count.
+
+   usage: fsm-kernel-bench [-e engines] [-n symbols] [-d uniform|weighted|cyclic]
+                           [-w weights] [-s seed] [-r repetitions] [-W warmups] [-c cpu]
+
+    -e  comma separated engines to run (default: all of them)
+          switch      the examples: precondition switch, then the int DELTA_PROC
+          branchy     one data dependent branch on the precondition, int table
+          table-int   precondition and restart folded into an int table, no branches
+          table-u8    the same table, as uint8_t with 4 (padded) columns
+          stride2     uint8_t table that consumes 2 symbols per lookup
+          stride4     uint8_t table that consumes 4 symbols per lookup
+          simd16      16 independent instances stepped together, one pshufb per step
+                      (SSSE3; plain C lanes otherwise); the stream is read as 16
+                      interleaved streams, so its count differs from the others
+    -n  length of the symbol stream
+    -d  distribution of the symbols: uniform, weighted by -w, or cyclic (ABCABC...)
+    -w  relative weights of A,B,C for -d weighted, e.g. 8,1,1
+    -s  seed of the stream
+    -r  timed repetitions; min, median, mean and standard deviation are reported
+    -W  untimed warmup repetitions
+    -c  pin to this cpu (Linux)
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#define _NUM_SYMBOLS 10000000;  // default stream length
+#define _REPETITIONS 10;
+#define _WARMUPS 2;
+#define MAX_REPETITIONS 1000
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A =  0,
+  B =  1,
+  C =  2,
+};
+
+// enum states - Q
+#define NUM_STATES 4
+enum {
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   DELTA_PROC is the table of the examples.  The other tables are derived from it
+   (and from the preconditions in EXPECT_PROC) by build_tables().
+*/
+
+int DELTA_PROC[NUM_STATES][NUM_SYMBOLS] = {{Q1,Q0,Q0},
+                                           {Q1,Q2,Q1},
+                                           {Q2,Q2,Q3},
+                                           {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+// symbol that satisfies the precondition of each state
+int EXPECT_PROC[NUM_STATES] = {A,B,C,-1};
+
+int GUARD_INT[NUM_STATES][NUM_SYMBOLS];     // precondition folded in, Q3 restarts like Q0
+uint8_t GUARD_U8[NUM_STATES*4];             // same, indexed by state<<2 | symbol
+uint8_t STRIDE2[NUM_STATES][9];             // state after 2 symbols, indexed by s1*3+s2
+uint8_t STRIDE2_FINALS[NUM_STATES][9];      // times Q3 was entered on the way
+uint8_t STRIDE4[NUM_STATES][81];
+uint8_t STRIDE4_FINALS[NUM_STATES][81];
+
+void build_tables (void) {
+  int q,s,i,k,state,finals,symbol;
+  for (q=0;q<NUM_STATES;q++)
+    for (s=0;s<NUM_SYMBOLS;s++) {
+      int from = (Q3 == q) ? Q0 : q; // a finished instance has already started over
+      GUARD_INT[q][s] = (s == EXPECT_PROC[from]) ? DELTA_PROC[from][s] : from;
+      GUARD_U8[q<<2 | s] = (uint8_t)GUARD_INT[q][s];
+    }
+  for (q=0;q<NUM_STATES;q++) {
+    GUARD_U8[q<<2 | 3] = (uint8_t)q; // padding column, never used
+    for (i=0;i<81;i++) {
+      state = q;
+      finals = 0;
+      for (k=0,symbol=i;k<4;k++) {
+        state = GUARD_INT[state][symbol % 3]; // least significant digit is the first symbol
+        finals += (Q3 == state);
+        symbol /= 3;
+        if (1 == k && i < 9) {
+          STRIDE2[q][i] = (uint8_t)state;
+          STRIDE2_FINALS[q][i] = (uint8_t)finals;
+        }
+      }
+      STRIDE4[q][i] = (uint8_t)state;
+      STRIDE4_FINALS[q][i] = (uint8_t)finals;
+    }
+  }
+}
+
+/*
+   Step engines
+   ^^^^^^^^^^^^
+   Each engine runs one instance (simd16: sixteen) over the n symbols of the stream
+   and returns the number of times the final state was reached.
+*/
+
+uint64_t run_switch (const uint8_t *symbols, size_t n) {
+  uint64_t finals = 0;
+  int my_state = Q0;
+  size_t i;
+  for (i=0;i<n;i++) {
+    switch (symbols[i]) {
+      case A:
+        if (Q0 == my_state)
+            my_state = next_state_proc(my_state,symbols[i]);
+        break;
+      case B:
+        if (Q1 == my_state)
+            my_state = next_state_proc(my_state,symbols[i]);
+        break;
+      case C:
+        if (Q2 == my_state) {
+            my_state = next_state_proc(my_state,symbols[i]);
+            ++finals;
+            my_state = Q0;
+        }
+        break;
+    }
+  }
+  return finals;
+}
+
+uint64_t run_branchy (const uint8_t *symbols, size_t n) {
+  uint64_t finals = 0;
+  int my_state = Q0;
+  size_t i;
+  for (i=0;i<n;i++) {
+    if (symbols[i] == EXPECT_PROC[my_state]) {
+      my_state = DELTA_PROC[my_state][symbols[i]];
+      if (Q3 == my_state) {
+        ++finals;
+        my_state = Q0;
+      }
+    }
+  }
+  return finals;
+}
+
+uint64_t run_table_int (const uint8_t *symbols, size_t n) {
+  uint64_t finals = 0;
+  int my_state = Q0;
+  size_t i;
+  for (i=0;i<n;i++) {
+    my_state = GUARD_INT[my_state][symbols[i]];
+    finals += (Q3 == my_state);
+  }
+  return finals;
+}
+
+uint64_t run_table_u8 (const uint8_t *symbols, size_t n) {
+  uint64_t finals = 0;
+  unsigned my_state = Q0;
+  size_t i;
+  for (i=0;i<n;i++) {
+    my_state = GUARD_U8[my_state<<2 | symbols[i]];
+    finals += (Q3 == my_state);
+  }
+  return finals;
+}
+
+// steps whatever stride2/stride4 leave over one symbol at a time
+uint64_t run_tail (const uint8_t *symbols, size_t n, unsigned *my_state) {
+  uint64_t finals = 0;
+  size_t i;
+  for (i=0;i<n;i++) {
+    *my_state = GUARD_U8[*my_state<<2 | symbols[i]];
+    finals += (Q3 == *my_state);
+  }
+  return finals;
+}
+
+uint64_t run_stride2 (const uint8_t *symbols, size_t n) {
+  uint64_t finals = 0;
+  unsigned my_state = Q0, pair;
+  size_t i;
+  for (i=0;i+2<=n;i+=2) {
+    pair = symbols[i] + 3*symbols[i+1];
+    finals += STRIDE2_FINALS[my_state][pair];
+    my_state = STRIDE2[my_state][pair];
+  }
+  return finals + run_tail(symbols+i,n-i,&my_state);
+}
+
+uint64_t run_stride4 (const uint8_t *symbols, size_t n) {
+  uint64_t finals = 0;
+  unsigned my_state = Q0, quad;
+  size_t i;
+  for (i=0;i+4<=n;i+=4) {
+    quad = symbols[i] + 3*symbols[i+1] + 9*symbols[i+2] + 27*symbols[i+3];
+    finals += STRIDE4_FINALS[my_state][quad];
+    my_state = STRIDE4[my_state][quad];
+  }
+  return finals + run_tail(symbols+i,n-i,&my_state);
+}
+
+// 16 instances; instance j gets symbols j, j+16, j+32, ...; the leftover tail is skipped
+uint64_t run_simd16_c (const uint8_t *symbols, size_t n) {
+  uint64_t finals = 0;
+  uint8_t states[16] = {0};
+  size_t i;
+  int j;
+  for (i=0;i+16<=n;i+=16)
+    for (j=0;j<16;j++) {
+      states[j] = GUARD_U8[states[j]<<2 | symbols[i+j]];
+      finals += (Q3 == states[j]);
+    }
+  return finals;
+}
+
+#ifdef __SSSE3__
+uint64_t run_simd16 (const uint8_t *symbols, size_t n) {
+  // the whole 16 entry table fits in one register, so pshufb does 16 lookups at once
+  const __m128i table = _mm_loadu_si128((const __m128i *)GUARD_U8);
+  const __m128i final = _mm_set1_epi8(Q3);
+  const __m128i one = _mm_set1_epi8(1);
+  __m128i states = _mm_setzero_si128(), counts = _mm_setzero_si128();
+  uint64_t finals = 0;
+  size_t i,steps = 0;
+  for (i=0;i+16<=n;i+=16) {
+    __m128i sym = _mm_loadu_si128((const __m128i *)(symbols+i));
+    states = _mm_shuffle_epi8(table,_mm_or_si128(_mm_slli_epi16(states,2),sym)); // states < 4, so no bits cross lanes
+    counts = _mm_add_epi8(counts,_mm_and_si128(_mm_cmpeq_epi8(states,final),one));
+    if (255 == ++steps) { // fold the 8 bit lane counters before they can wrap
+      __m128i sums = _mm_sad_epu8(counts,_mm_setzero_si128());
+      finals += (uint64_t)_mm_cvtsi128_si32(sums) + (uint64_t)_mm_extract_epi16(sums,4);
+      counts = _mm_setzero_si128();
+      steps = 0;
+    }
+  }
+  __m128i sums = _mm_sad_epu8(counts,_mm_setzero_si128());
+  return finals + (uint64_t)_mm_cvtsi128_si32(sums) + (uint64_t)_mm_extract_epi16(sums,4);
+}
+#else
+uint64_t run_simd16 (const uint8_t *symbols, size_t n) {
+  return run_simd16_c(symbols,n);
+}
+#endif
+
+struct engine {
+  const char *name;
+  uint64_t (*run)(const uint8_t *, size_t);
+  uint64_t (*reference)(const uint8_t *, size_t);  // what the count has to match
+};
+
+struct engine ENGINES[] = {
+  {"switch",    run_switch,    run_switch},
+  {"branchy",   run_branchy,   run_switch},
+  {"table-int", run_table_int, run_switch},
+  {"table-u8",  run_table_u8,  run_switch},
+  {"stride2",   run_stride2,   run_switch},
+  {"stride4",   run_stride4,   run_switch},
+  {"simd16",    run_simd16,    run_simd16_c},
+};
+#define NUM_ENGINES (int)(sizeof(ENGINES)/sizeof(ENGINES[0]))
+
+/*
+   Symbol streams
+   ^^^^^^^^^^^^^^
+   splitmix64, as in Example 7, so that a stream can be reproduced from its seed.
+*/
+
+uint64_t next_random (uint64_t *stream) {
+  uint64_t z = (*stream += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void fill_stream (uint8_t *symbols, size_t n, const char *distribution, const int *weights, uint64_t seed) {
+  uint64_t stream = seed, total = weights[0] + weights[1] + weights[2], r;
+  size_t i;
+  for (i=0;i<n;i++) {
+    if (0 == strcmp(distribution,"cyclic")) {
+      symbols[i] = (uint8_t)(i % NUM_SYMBOLS);
+    } else if (0 == strcmp(distribution,"weighted")) {
+      r = next_random(&stream) % total;
+      symbols[i] = (r < (uint64_t)weights[0]) ? A : (r < (uint64_t)(weights[0]+weights[1])) ? B : C;
+    } else {
+      symbols[i] = (uint8_t)(next_random(&stream) % NUM_SYMBOLS);
+    }
+  }
+}
+
+double get_time (void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec/1.0e9;
+}
+
+int compare_doubles (const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+  long NUM=_NUM_SYMBOLS;
+  int REPETITIONS=_REPETITIONS;
+  int WARMUPS=_WARMUPS;
+  char engines_list[1024] = "";
+  char distribution[32] = "uniform";
+  int weights[3] = {1,1,1};
+  uint64_t seed = 1;
+  int cpu = -1;
+  int e,r,opt,failures=0;
+  double t,ns[MAX_REPETITIONS],sum,sumsq,mean;
+  uint64_t finals,expected;
+  uint8_t *symbols;
+
+  while (-1 != (opt = getopt(argc,argv,"e:n:d:w:s:r:W:c:"))) {
+    switch (opt) {
+      case 'e': snprintf(engines_list,sizeof(engines_list),",%s,",optarg); break;
+      case 'n': NUM = atol(optarg); break;
+      case 'd': snprintf(distribution,sizeof(distribution),"%s",optarg); break;
+      case 'w': sscanf(optarg,"%d,%d,%d",&weights[0],&weights[1],&weights[2]); break;
+      case 's': seed = strtoull(optarg,NULL,0); break;
+      case 'r': REPETITIONS = atoi(optarg); break;
+      case 'W': WARMUPS = atoi(optarg); break;
+      case 'c': cpu = atoi(optarg); break;
+      default:
+        fprintf(stderr,"usage: %s [-e engines] [-n symbols] [-d uniform|weighted|cyclic] [-w weights] "
+                       "[-s seed] [-r repetitions] [-W warmups] [-c cpu]\n",argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+  if (NUM < 1 || REPETITIONS < 1 || REPETITIONS > MAX_REPETITIONS || weights[0]+weights[1]+weights[2] < 1) {
+    fprintf(stderr,"need -n > 0, 0 < -r <= %d and some positive weight\n",MAX_REPETITIONS);
+    exit(EXIT_FAILURE);
+  }
+  if (cpu >= 0) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu,&set);
+    if (0 != sched_setaffinity(0,sizeof(set),&set))
+        perror("sched_setaffinity");
+#else
+    fprintf(stderr,"pinning is only supported on Linux, ignoring -c\n");
+#endif
+  }
+
+  build_tables();
+  if (NULL == (symbols = malloc(NUM))) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  fill_stream(symbols,NUM,distribution,weights,seed);
+
+  printf("%ld %s symbols, %d repetitions after %d warmups%s\n",NUM,distribution,REPETITIONS,WARMUPS,
+#ifdef __SSSE3__
+         ""
+#else
+         ", simd16 without SSSE3"
+#endif
+         );
+  printf("%-10s %10s %10s %10s %10s %12s\n","engine","min ns","median ns","mean ns","stddev","finals");
+  for (e=0;e<NUM_ENGINES;e++) {
+    char key[64];
+    snprintf(key,sizeof(key),",%s,",ENGINES[e].name);
+    if ('\0' != engines_list[0] && NULL == strstr(engines_list,key))
+        continue;
+    expected = ENGINES[e].reference(symbols,NUM);
+    for (r=0;r<WARMUPS;r++)
+        ENGINES[e].run(symbols,NUM);
+    finals = 0;
+    for (r=0;r<REPETITIONS;r++) {
+      t = get_time();
+      finals = ENGINES[e].run(symbols,NUM);
+      ns[r] = (get_time() - t) * 1.0e9 / NUM;
+    }
+    sum = sumsq = 0.0;
+    for (r=0;r<REPETITIONS;r++) {
+      sum += ns[r];
+      sumsq += ns[r]*ns[r];
+    }
+    mean = sum / REPETITIONS;
+    qsort(ns,REPETITIONS,sizeof(double),compare_doubles);
+    printf("%-10s %10.3f %10.3f %10.3f %10.3f %12llu%s\n",ENGINES[e].name,ns[0],ns[REPETITIONS/2],mean,
+           sqrt(fmax(0.0,sumsq/REPETITIONS - mean*mean)),(unsigned long long)finals,
+           (finals == expected) ? "" : "  MISMATCH");
+    if (finals != expected)
+        ++failures;
+  }
+
+  free(symbols);
+  exit((failures) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,335 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   libfsmnet
+   ^^^^^^^^^
+   A PMPI shim that makes the FSM message paths behave as if the ranks were talking
+   over a network instead of shared memory, so that batching, pipelining and flow
+   control can be judged on a single box.  Like libfsmprof it is linked ahead of the
+   MPI library (or LD_PRELOADed) and nothing in the application has to change.  The
+   two cannot be stacked, since each one owns the MPI_* entry points.
+
+   The link model, per rank, is a NIC that serializes messages at the configured
+   bandwidth followed by a wire with a fixed latency plus jitter:
+
+    - MPI_Send and MPI_Isend pack the message and queue it; it is handed to MPI
+      (as MPI_PACKED, with PMPI_Isend) only once it has "arrived", i.e. after the
+      NIC was free, the bytes were serialized, and the latency and jitter passed.
+      MPI_Send returns once its bytes are serialized, MPI_Isend at once; the
+      receiver pays the latency, and only if it has nothing else to do
+    - messages leave the queue in the order they were sent, so MPI's ordering
+      guarantees still hold
+    - MPI_Recv costs the configured receive overhead on top
+    - MPI_Bcast takes at least ceil(log2(simulated nodes)) hops of latency plus
+      serialization
+    - ranks on the same simulated node (FSM_NET_RANKS_PER_NODE consecutive world
+      ranks) talk without delay
+
+   The queue is worked off whenever the rank is inside an intercepted call; blocking
+   calls (MPI_Recv, MPI_Wait*, MPI_Probe) poll instead of blocking so that a rank
+   waiting for a reply still delivers its own messages, and the collectives and
+   MPI_Comm_free first hand everything queued to MPI.  Other calls (MPI_Irecv,
+   persistent requests, RMA, the nonblocking collectives) are not delayed.
+
+   The model is set in the environment:
+
+     FSM_NET_LATENCY_US        one way latency              (default 2)
+     FSM_NET_BANDWIDTH_MBS     MB/s per rank                (default 10000)
+     FSM_NET_JITTER_US         uniform extra latency, 0..j  (default 0)
+     FSM_NET_RECV_OVERHEAD_US  CPU time per MPI_Recv        (default 0)
+     FSM_NET_RANKS_PER_NODE    ranks sharing a node         (default 1)
+     FSM_NET_SEED              seed of the jitter           (default 1)
+
+   e.g.,
+
+     mpirun -np 4 -x LD_PRELOAD=$PWD/bin/libfsmnet.so -x FSM_NET_LATENCY_US=50 bin/mpi-fsm-9
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi.h"
+
+struct net_msg {
+  double release;       // when the message has arrived and may be handed to MPI
+  void *packed;
+  int size;
+  int dest;
+  int tag;
+  MPI_Comm comm;
+  MPI_Request greq;     // what the application waits on (MPI_Isend), or MPI_REQUEST_NULL
+  MPI_Request req;      // the real send, MPI_REQUEST_NULL until it is handed to MPI
+  struct net_msg *next;
+};
+
+static struct net_msg *net_head, *net_tail;
+static double net_latency, net_byte_time, net_jitter, net_recv_overhead;  // seconds
+static double net_link_free, net_last_release;
+static int net_ranks_per_node, net_world_rank;
+static unsigned net_seed;
+static MPI_Group net_world_group;
+
+static double get_env (const char *name, double value) {
+  const char *s = getenv(name);
+  return (NULL != s) ? atof(s) : value;
+}
+
+static void net_init (void) {
+  double bandwidth = get_env("FSM_NET_BANDWIDTH_MBS",10000.0);
+  net_latency = get_env("FSM_NET_LATENCY_US",2.0) / 1.0e6;
+  net_jitter = get_env("FSM_NET_JITTER_US",0.0) / 1.0e6;
+  net_recv_overhead = get_env("FSM_NET_RECV_OVERHEAD_US",0.0) / 1.0e6;
+  net_byte_time = (bandwidth > 0.0) ? 1.0 / (bandwidth * 1.0e6) : 0.0;
+  net_ranks_per_node = (int)get_env("FSM_NET_RANKS_PER_NODE",1.0);
+  if (net_ranks_per_node < 1)
+      net_ranks_per_node = 1;
+  PMPI_Comm_rank(MPI_COMM_WORLD,&net_world_rank);
+  PMPI_Comm_group(MPI_COMM_WORLD,&net_world_group);
+  net_seed = (unsigned)get_env("FSM_NET_SEED",1.0) + net_world_rank;
+}
+
+// whether rank of comm is on another simulated node
+static int net_is_remote (MPI_Comm comm, int rank) {
+  MPI_Group group;
+  int world_rank = rank;
+  if (MPI_PROC_NULL == rank || MPI_ANY_SOURCE == rank)
+      return 0;
+  if (MPI_COMM_WORLD != comm) {
+    PMPI_Comm_group(comm,&group);
+    PMPI_Group_translate_ranks(group,1,&rank,net_world_group,&world_rank);
+    PMPI_Group_free(&group);
+  }
+  return MPI_UNDEFINED != world_rank && world_rank/net_ranks_per_node != net_world_rank/net_ranks_per_node;
+}
+
+// hands arrived messages to MPI, in order, and retires the ones MPI is done with
+static void net_progress (void) {
+  struct net_msg *m, *prev = NULL, *next;
+  double now = PMPI_Wtime();
+  int flag, blocked = 0;
+  for (m=net_head;NULL!=m;m=next) {
+    next = m->next;
+    if (MPI_REQUEST_NULL == m->req) {
+      if (blocked || m->release > now) {
+        blocked = 1; // nothing may overtake it
+        prev = m;
+        continue;
+      }
+      PMPI_Isend(m->packed,m->size,MPI_PACKED,m->dest,m->tag,m->comm,&m->req);
+    }
+    PMPI_Test(&m->req,&flag,MPI_STATUS_IGNORE);
+    if (!flag) {
+      prev = m;
+      continue;
+    }
+    if (MPI_REQUEST_NULL != m->greq)
+        PMPI_Grequest_complete(m->greq);
+    if (NULL == prev)
+        net_head = next;
+    else
+        prev->next = next;
+    if (net_tail == m)
+        net_tail = prev;
+    free(m->packed);
+    free(m);
+  }
+}
+
+static void net_spin_until (double until) {
+  while (PMPI_Wtime() < until)
+      net_progress();
+}
+
+// waits until everything queued has been handed to MPI (not until it is received)
+static void net_flush (void) {
+  net_spin_until(net_last_release); // release times never decrease along the queue
+  net_progress();
+}
+
+static int grequest_query (void *extra_state, MPI_Status *status) {
+  PMPI_Status_set_elements(status,MPI_BYTE,0);
+  PMPI_Status_set_cancelled(status,0);
+  status->MPI_SOURCE = MPI_UNDEFINED;
+  status->MPI_TAG = MPI_UNDEFINED;
+  return MPI_SUCCESS;
+}
+
+static int grequest_free (void *extra_state) {
+  return MPI_SUCCESS;
+}
+
+static int grequest_cancel (void *extra_state, int complete) {
+  return MPI_SUCCESS;
+}
+
+// queues a copy of the message, returns when its bytes have left the NIC
+static double net_enqueue (const void *buf, int count, MPI_Datatype type, int dest, int tag,
+                           MPI_Comm comm, MPI_Request greq) {
+  struct net_msg *m = calloc(1,sizeof(struct net_msg));
+  double now = PMPI_Wtime(), done = now;
+  int size, position = 0;
+
+  PMPI_Pack_size(count,type,comm,&size);
+  if (NULL == m || NULL == (m->packed = malloc((size > 0) ? size : 1))) {
+    fprintf(stderr,"libfsmnet: out of memory queueing a %d byte message\n",size);
+    PMPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  PMPI_Pack(buf,count,type,m->packed,size,&position,comm);
+  m->size = position;
+  m->dest = dest;
+  m->tag = tag;
+  m->comm = comm;
+  m->greq = greq;
+  m->req = MPI_REQUEST_NULL;
+  m->release = now;
+  if (net_is_remote(comm,dest)) {
+    net_link_free = ((net_link_free > now) ? net_link_free : now) + position*net_byte_time;
+    done = net_link_free;
+    m->release = net_link_free + net_latency + net_jitter*((double)rand_r(&net_seed)/RAND_MAX);
+  }
+  if (m->release < net_last_release)
+      m->release = net_last_release; // keep the order it was sent in
+  net_last_release = m->release;
+  if (NULL == net_tail)
+      net_head = m;
+  else
+      net_tail->next = m;
+  net_tail = m;
+  return done;
+}
+
+// Intercepted calls
+
+int MPI_Init (int *argc, char ***argv) {
+  int rc = PMPI_Init(argc,argv);
+  net_init();
+  return rc;
+}
+
+int MPI_Init_thread (int *argc, char ***argv, int required, int *provided) {
+  int rc = PMPI_Init_thread(argc,argv,required,provided);
+  net_init();
+  return rc;
+}
+
+int MPI_Finalize (void) {
+  while (NULL != net_head)
+      net_progress();
+  PMPI_Group_free(&net_world_group);
+  return PMPI_Finalize();
+}
+
+int MPI_Send (const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+  if (NULL == net_head && !net_is_remote(comm,dest))
+      return PMPI_Send(buf,count,type,dest,tag,comm);
+  net_spin_until(net_enqueue(buf,count,type,dest,tag,comm,MPI_REQUEST_NULL));
+  return MPI_SUCCESS;
+}
+
+int MPI_Isend (const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm, MPI_Request *req) {
+  if (NULL == net_head && !net_is_remote(comm,dest))
+      return PMPI_Isend(buf,count,type,dest,tag,comm,req);
+  PMPI_Grequest_start(grequest_query,grequest_free,grequest_cancel,NULL,req);
+  net_enqueue(buf,count,type,dest,tag,comm,*req);
+  net_progress();
+  return MPI_SUCCESS;
+}
+
+int MPI_Recv (void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+  MPI_Request req;
+  MPI_Status s;
+  int flag = 0;
+  int rc = PMPI_Irecv(buf,count,type,source,tag,comm,&req);
+  while (MPI_SUCCESS == rc && !flag) {
+    net_progress();
+    rc = PMPI_Test(&req,&flag,&s);
+  }
+  if (net_recv_overhead > 0.0 && net_is_remote(comm,s.MPI_SOURCE))
+      net_spin_until(PMPI_Wtime() + net_recv_overhead);
+  if (MPI_STATUS_IGNORE != status)
+      *status = s;
+  return rc;
+}
+
+int MPI_Iprobe (int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status) {
+  net_progress();
+  return PMPI_Iprobe(source,tag,comm,flag,status);
+}
+
+int MPI_Probe (int source, int tag, MPI_Comm comm, MPI_Status *status) {
+  int flag = 0, rc = MPI_SUCCESS;
+  while (MPI_SUCCESS == rc && !flag) {
+    net_progress();
+    rc = PMPI_Iprobe(source,tag,comm,&flag,status);
+  }
+  return rc;
+}
+
+int MPI_Test (MPI_Request *req, int *flag, MPI_Status *status) {
+  net_progress();
+  return PMPI_Test(req,flag,status);
+}
+
+int MPI_Wait (MPI_Request *req, MPI_Status *status) {
+  int flag = 0, rc = MPI_SUCCESS;
+  while (MPI_SUCCESS == rc && !flag) {
+    net_progress();
+    rc = PMPI_Test(req,&flag,status);
+  }
+  return rc;
+}
+
+int MPI_Waitall (int count, MPI_Request reqs[], MPI_Status statuses[]) {
+  int flag = 0, rc = MPI_SUCCESS;
+  while (MPI_SUCCESS == rc && !flag) {
+    net_progress();
+    rc = PMPI_Testall(count,reqs,&flag,statuses);
+  }
+  return rc;
+}
+
+int MPI_Bcast (void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+  int size, type_size, nodes, hops = 0;
+  double t;
+  net_flush();
+  t = PMPI_Wtime();
+  int rc = PMPI_Bcast(buf,count,type,root,comm);
+  PMPI_Comm_size(comm,&size);
+  PMPI_Type_size(type,&type_size);
+  for (nodes=(size+net_ranks_per_node-1)/net_ranks_per_node;(1<<hops)<nodes;hops++)
+      ;
+  net_spin_until(t + hops*(net_latency + (double)count*type_size*net_byte_time));
+  return rc;
+}
+
+int MPI_Scatterv (const void *sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+                  void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+  net_flush();
+  return PMPI_Scatterv(sendbuf,sendcounts,displs,sendtype,recvbuf,recvcount,recvtype,root,comm);
+}
+
+int MPI_Reduce (const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm) {
+  net_flush();
+  return PMPI_Reduce(sendbuf,recvbuf,count,type,op,root,comm);
+}
+
+int MPI_Allreduce (const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+  net_flush();
+  return PMPI_Allreduce(sendbuf,recvbuf,count,type,op,comm);
+}
+
+int MPI_Gather (const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+  net_flush();
+  return PMPI_Gather(sendbuf,sendcount,sendtype,recvbuf,recvcount,recvtype,root,comm);
+}
+
+int MPI_Barrier (MPI_Comm comm) {
+  net_flush();
+  return PMPI_Barrier(comm);
+}
+
+int MPI_Comm_free (MPI_Comm *comm) {
+  net_flush();
+  return PMPI_Comm_free(comm);
+}
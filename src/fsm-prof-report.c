@@ -0,0 +1,101 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   fsm-prof-report
+   ^^^^^^^^^^^^^^^
+   Summarizes the profiles written by libfsmprof (see fsm-prof.c).  For every rank it
+   prints, per intercepted call and tag, the number of calls, bytes, time spent in the
+   call (also as a share of the rank's run time) and, for MPI_Iprobe, the hit ratio;
+   then the same totals over all ranks.
+
+   usage: fsm-prof-report fsm-prof.*.bin
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fsm-prof.h"
+
+const char *PROF_CALL_NAMES[PROF_NUM_CALLS] = {
+  "MPI_Send","MPI_Isend","MPI_Recv","MPI_Iprobe","MPI_Wait*",
+  "MPI_Bcast","MPI_Scatterv","MPI_Reduce","MPI_Gather","MPI_Barrier"
+};
+
+struct prof_entry {
+  uint64_t calls;
+  uint64_t bytes;
+  uint64_t hits;
+  double seconds;
+};
+
+void print_row (const char *who, int call, const char *tag, const struct prof_entry *e, double elapsed) {
+  printf("%-6s %-13s %5s %12llu %14llu %12.6f %6.1f%%",who,PROF_CALL_NAMES[call],tag,
+         (unsigned long long)e->calls,(unsigned long long)e->bytes,e->seconds,
+         (elapsed > 0.0) ? 100.0*e->seconds/elapsed : 0.0);
+  if (PROF_IPROBE == call)
+      printf("  hits %llu/%llu (%.1f%%)",(unsigned long long)e->hits,(unsigned long long)e->calls,
+             100.0*e->hits/e->calls);
+  printf("\n");
+}
+
+int main(int argc, char** argv) {
+  struct prof_header header;
+  struct prof_record record;
+  struct prof_entry totals[PROF_NUM_CALLS];
+  struct prof_entry e;
+  double total_elapsed = 0.0;
+  char who[16],tag[16];
+  int i,r,call,failures=0;
+  FILE *in;
+
+  if (argc < 2) {
+    fprintf(stderr,"usage: %s fsm-prof.*.bin\n",argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  memset(totals,0,sizeof(totals));
+  printf("%-6s %-13s %5s %12s %14s %12s %7s\n","rank","call","tag","calls","bytes","seconds","time");
+  for (i=1;i<argc;i++) {
+    if (NULL == (in = fopen(argv[i],"rb"))) {
+      perror(argv[i]);
+      ++failures;
+      continue;
+    }
+    if (1 != fread(&header,sizeof(header),1,in) || 0 != memcmp(header.magic,PROF_MAGIC,sizeof(header.magic))) {
+      fprintf(stderr,"%s: not an fsm-prof profile\n",argv[i]);
+      fclose(in);
+      ++failures;
+      continue;
+    }
+    snprintf(who,sizeof(who),"%d",header.rank);
+    total_elapsed += header.elapsed;
+    for (r=0;r<header.num_records;r++) {
+      if (1 != fread(&record,sizeof(record),1,in) || record.call < 0 || record.call >= PROF_NUM_CALLS) {
+        fprintf(stderr,"%s: truncated or corrupt\n",argv[i]);
+        ++failures;
+        break;
+      }
+      e.calls = record.calls;
+      e.bytes = record.bytes;
+      e.hits = record.hits;
+      e.seconds = record.seconds;
+      if (PROF_OTHER_TAG == record.tag)
+          snprintf(tag,sizeof(tag),"-");
+      else
+          snprintf(tag,sizeof(tag),"%d",record.tag);
+      print_row(who,record.call,tag,&e,header.elapsed);
+      totals[record.call].calls += e.calls;
+      totals[record.call].bytes += e.bytes;
+      totals[record.call].hits += e.hits;
+      totals[record.call].seconds += e.seconds;
+    }
+    printf("%-6s %-13s %5s %12s %14s %12.6f\n",who,"(run time)","","","",header.elapsed);
+    fclose(in);
+  }
+
+  printf("\n");
+  for (call=0;call<PROF_NUM_CALLS;call++)
+    if (totals[call].calls)
+        print_row("all",call,"*",&totals[call],total_elapsed);
+
+  exit((failures) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,212 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   libfsmprof
+   ^^^^^^^^^^
+   A PMPI profiler for the FSM message paths.  Linked ahead of the MPI library (or
+   LD_PRELOADed), it intercepts the point to point calls and collectives used by the
+   examples and keeps, per call and per tag, the number of calls, the bytes moved and
+   the wall time spent inside the call, plus the hit count of MPI_Iprobe.  Nothing in
+   the application has to change.
+
+   At MPI_Finalize each rank writes its profile to fsm-prof.<rank>.bin, in the
+   directory named by $FSM_PROF_DIR or the current directory; the layout is in
+   fsm-prof.h and fsm-prof-report turns a set of them into tables.
+
+   e.g.,
+
+     mpirun -np 4 -x LD_PRELOAD=$PWD/bin/libfsmprof.so bin/mpi-fsm-3
+     bin/fsm-prof-report fsm-prof.*.bin
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi.h"
+#include "fsm-prof.h"
+
+struct prof_entry {
+  uint64_t calls;
+  uint64_t bytes;
+  uint64_t hits;
+  double seconds;
+};
+
+static struct prof_entry prof[PROF_NUM_CALLS][PROF_NUM_TAGS];
+static double prof_start;
+
+static int get_slot (int tag) {
+  return (tag >= 0 && tag < PROF_OTHER_TAG) ? tag : PROF_OTHER_TAG;
+}
+
+static uint64_t get_bytes (int count, MPI_Datatype type) {
+  int size;
+  PMPI_Type_size(type,&size);
+  return (uint64_t)count * (uint64_t)size;
+}
+
+static void account (int call, int tag, uint64_t bytes, double seconds) {
+  struct prof_entry *e = &prof[call][get_slot(tag)];
+  ++e->calls;
+  e->bytes += bytes;
+  e->seconds += seconds;
+}
+
+static void write_profile (void) {
+  struct prof_header header;
+  struct prof_record record;
+  const char *dir = getenv("FSM_PROF_DIR");
+  char path[4096];
+  int call,tag,rank,size;
+  FILE *out;
+
+  PMPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  PMPI_Comm_size(MPI_COMM_WORLD,&size);
+  snprintf(path,sizeof(path),"%s/fsm-prof.%d.bin",(NULL != dir) ? dir : ".",rank);
+  if (NULL == (out = fopen(path,"wb"))) {
+    perror(path);
+    return;
+  }
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,PROF_MAGIC,sizeof(header.magic));
+  header.rank = rank;
+  header.num_ranks = size;
+  header.elapsed = PMPI_Wtime() - prof_start;
+  for (call=0;call<PROF_NUM_CALLS;call++)
+    for (tag=0;tag<PROF_NUM_TAGS;tag++)
+      if (prof[call][tag].calls)
+          ++header.num_records;
+  fwrite(&header,sizeof(header),1,out);
+  for (call=0;call<PROF_NUM_CALLS;call++)
+    for (tag=0;tag<PROF_NUM_TAGS;tag++) {
+      if (!prof[call][tag].calls)
+          continue;
+      memset(&record,0,sizeof(record));
+      record.call = call;
+      record.tag = tag;
+      record.calls = prof[call][tag].calls;
+      record.bytes = prof[call][tag].bytes;
+      record.hits = prof[call][tag].hits;
+      record.seconds = prof[call][tag].seconds;
+      fwrite(&record,sizeof(record),1,out);
+    }
+  fclose(out);
+}
+
+// Intercepted calls
+
+int MPI_Init (int *argc, char ***argv) {
+  int rc = PMPI_Init(argc,argv);
+  prof_start = PMPI_Wtime();
+  return rc;
+}
+
+int MPI_Init_thread (int *argc, char ***argv, int required, int *provided) {
+  int rc = PMPI_Init_thread(argc,argv,required,provided);
+  prof_start = PMPI_Wtime();
+  return rc;
+}
+
+int MPI_Finalize (void) {
+  write_profile();
+  return PMPI_Finalize();
+}
+
+int MPI_Send (const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Send(buf,count,type,dest,tag,comm);
+  account(PROF_SEND,tag,get_bytes(count,type),PMPI_Wtime()-t);
+  return rc;
+}
+
+int MPI_Isend (const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm, MPI_Request *req) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Isend(buf,count,type,dest,tag,comm,req);
+  account(PROF_ISEND,tag,get_bytes(count,type),PMPI_Wtime()-t);
+  return rc;
+}
+
+int MPI_Recv (void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+  MPI_Status local;
+  int received = 0;
+  double t = PMPI_Wtime();
+  int rc;
+  if (MPI_STATUS_IGNORE == status)
+      status = &local; // need the actual tag and size
+  rc = PMPI_Recv(buf,count,type,source,tag,comm,status);
+  t = PMPI_Wtime() - t;
+  PMPI_Get_count(status,type,&received);
+  account(PROF_RECV,status->MPI_TAG,(MPI_UNDEFINED == received) ? 0 : get_bytes(received,type),t);
+  return rc;
+}
+
+// the call and the hit both go to the tag asked for, so hits/calls is the share of probes on that tag that found something
+int MPI_Iprobe (int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Iprobe(source,tag,comm,flag,status);
+  account(PROF_IPROBE,tag,0,PMPI_Wtime()-t);
+  if (*flag)
+      ++prof[PROF_IPROBE][get_slot(tag)].hits;
+  return rc;
+}
+
+int MPI_Wait (MPI_Request *req, MPI_Status *status) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Wait(req,status);
+  account(PROF_WAIT,PROF_OTHER_TAG,0,PMPI_Wtime()-t);
+  return rc;
+}
+
+int MPI_Waitall (int count, MPI_Request reqs[], MPI_Status statuses[]) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Waitall(count,reqs,statuses);
+  account(PROF_WAIT,PROF_OTHER_TAG,0,PMPI_Wtime()-t);
+  return rc;
+}
+
+int MPI_Bcast (void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Bcast(buf,count,type,root,comm);
+  account(PROF_BCAST,PROF_OTHER_TAG,get_bytes(count,type),PMPI_Wtime()-t);
+  return rc;
+}
+
+int MPI_Scatterv (const void *sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+                  void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+  int i,rank,size;
+  uint64_t bytes = 0;
+  double t = PMPI_Wtime();
+  int rc = PMPI_Scatterv(sendbuf,sendcounts,displs,sendtype,recvbuf,recvcount,recvtype,root,comm);
+  t = PMPI_Wtime() - t;
+  PMPI_Comm_rank(comm,&rank);
+  if (root == rank) {
+    PMPI_Comm_size(comm,&size);
+    for (i=0;i<size;i++) bytes += get_bytes(sendcounts[i],sendtype);
+  } else {
+    bytes = get_bytes(recvcount,recvtype);
+  }
+  account(PROF_SCATTERV,PROF_OTHER_TAG,bytes,t);
+  return rc;
+}
+
+int MPI_Reduce (const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Reduce(sendbuf,recvbuf,count,type,op,root,comm);
+  account(PROF_REDUCE,PROF_OTHER_TAG,get_bytes(count,type),PMPI_Wtime()-t);
+  return rc;
+}
+
+int MPI_Gather (const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Gather(sendbuf,sendcount,sendtype,recvbuf,recvcount,recvtype,root,comm);
+  account(PROF_GATHER,PROF_OTHER_TAG,get_bytes(sendcount,sendtype),PMPI_Wtime()-t);
+  return rc;
+}
+
+int MPI_Barrier (MPI_Comm comm) {
+  double t = PMPI_Wtime();
+  int rc = PMPI_Barrier(comm);
+  account(PROF_BARRIER,PROF_OTHER_TAG,0,PMPI_Wtime()-t);
+  return rc;
+}
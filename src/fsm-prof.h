@@ -0,0 +1,55 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   fsm-prof.h
+   ^^^^^^^^^^
+   Layout of the binary profiles written by libfsmprof (fsm-prof.c) and read by
+   fsm-prof-report (fsm-prof-report.c).  A profile is one file per rank, named
+   fsm-prof.<rank>.bin, holding a struct prof_header followed by num_records
+   struct prof_record, one for every (call, tag) pair that was used at least once.
+*/
+
+#ifndef FSM_PROF_H
+#define FSM_PROF_H
+
+#include <stdint.h>
+
+#define PROF_MAGIC "FSMPROF1"
+#define PROF_NUM_TAGS 64   // tags 0 thru PROF_NUM_TAGS-2 are kept apart, all others share PROF_OTHER_TAG
+#define PROF_OTHER_TAG (PROF_NUM_TAGS-1)
+
+// enumerate the intercepted calls
+enum {
+  PROF_SEND     = 0,
+  PROF_ISEND    = 1,
+  PROF_RECV     = 2,
+  PROF_IPROBE   = 3,
+  PROF_WAIT     = 4,  // MPI_Wait and MPI_Waitall
+  PROF_BCAST    = 5,
+  PROF_SCATTERV = 6,
+  PROF_REDUCE   = 7,
+  PROF_GATHER   = 8,
+  PROF_BARRIER  = 9,
+  PROF_NUM_CALLS
+};
+
+struct prof_header {
+  char magic[8];
+  int32_t rank;
+  int32_t num_ranks;
+  int32_t num_records;
+  int32_t pad;
+  double elapsed;       // seconds from MPI_Init to MPI_Finalize
+};
+
+struct prof_record {
+  int32_t call;
+  int32_t tag;          // PROF_OTHER_TAG for collectives, MPI_ANY_TAG and large tags; for MPI_Iprobe
+                        // the tag asked for, not the tag of the message found
+  uint64_t calls;
+  uint64_t bytes;       // sent, received or broadcast by this rank
+  uint64_t hits;        // MPI_Iprobe only: calls that found a message
+  double seconds;       // wall time spent inside the call
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   fsm-trace
+   ^^^^^^^^^
+   Merges the per-rank binary transition traces (see fsm-trace.h) by time and renders
+   them in the text format the examples print, e.g. "Node 2 now in state 1".  Only
+   one record per trace is held in memory at a time, so traces of any length can be
+   merged.
+
+   usage: fsm-trace [-t] fsm-trace.*.bin
+
+    -t  prefix every line with its time in seconds
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fsm-trace.h"
+
+struct trace {
+  FILE *file;
+  struct trace_header header;
+  struct trace_record next;
+  int live;             // next holds a record that has not been printed yet
+};
+
+void advance (struct trace *t) {
+  t->live = (1 == fread(&t->next,sizeof(t->next),1,t->file));
+}
+
+int main(int argc, char** argv) {
+  struct trace *traces;
+  struct trace_record *r;
+  int i,opt,best,num_traces=0,show_time=0,failures=0;
+
+  while (-1 != (opt = getopt(argc,argv,"t"))) {
+    switch (opt) {
+      case 't': show_time = 1; break;
+      default:
+        fprintf(stderr,"usage: %s [-t] fsm-trace.*.bin\n",argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+  if (optind == argc) {
+    fprintf(stderr,"usage: %s [-t] fsm-trace.*.bin\n",argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  traces = calloc(argc-optind,sizeof(struct trace));
+  if (NULL == traces) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+  for (i=optind;i<argc;i++) {
+    struct trace *t = &traces[num_traces];
+    if (NULL == (t->file = fopen(argv[i],"rb"))) {
+      perror(argv[i]);
+      ++failures;
+      continue;
+    }
+    if (1 != fread(&t->header,sizeof(t->header),1,t->file) || 0 != memcmp(t->header.magic,TRACE_MAGIC,sizeof(t->header.magic))) {
+      fprintf(stderr,"%s: not an fsm trace\n",argv[i]);
+      fclose(t->file);
+      ++failures;
+      continue;
+    }
+    advance(t);
+    ++num_traces;
+  }
+
+  // k-way merge; the number of ranks is small enough for a linear scan of the heads
+  while (1) {
+    best = -1;
+    for (i=0;i<num_traces;i++)
+        if (traces[i].live && (best < 0 || traces[i].next.time < traces[best].next.time))
+            best = i;
+    if (best < 0)
+        break;
+    r = &traces[best].next;
+    if (show_time)
+        printf("%.9f ",r->time);
+    if (traces[best].header.final_state == r->new_state)
+        printf("Node %d now in FINAL state %d\n",r->rank,r->new_state);
+    else
+        printf("Node %d now in state %d\n",r->rank,r->new_state);
+    advance(&traces[best]);
+  }
+
+  for (i=0;i<num_traces;i++)
+      fclose(traces[i].file);
+  free(traces);
+  exit((failures) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,34 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   fsm-trace.h
+   ^^^^^^^^^^^
+   Layout of the binary transition traces written by the examples that trace (e.g.
+   mpi-fsm-13.c) and read by fsm-trace (fsm-trace.c).  A trace is one file per rank,
+   named fsm-trace.<rank>.bin, holding a struct trace_header followed by any number
+   of struct trace_record, in the order the transitions happened on that rank.
+*/
+
+#ifndef FSM_TRACE_H
+#define FSM_TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "FSMTRACE"
+
+struct trace_header {
+  char magic[8];
+  int32_t rank;
+  int32_t final_state;  // new_state values equal to this are rendered as FINAL
+  double clock_offset;  // seconds added to this rank's MPI_Wtime() to get ROOT's
+};
+
+struct trace_record {
+  double time;          // seconds since ROOT left the start barrier, on ROOT's clock
+  int32_t rank;
+  int32_t old_state;
+  int32_t symbol;
+  int32_t new_state;
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 10 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to show how to move LARGE payloads.  Once
+   _MSG_SIZE grows to megabytes, ROOT sending the whole payload to one node after the
+   other leaves every other node idle.  Here ROOT only talks to its children in a chain
+   or a binary tree, every node forwards what it receives to its own children, and the
+   payload is cut into segments so that all the links of the path are busy at the same
+   time (i.e., the payload is pipelined through the path).
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-10 [msg bytes] [segment bytes] [chain|tree]
+    - the payload is a heap allocated array of integers (msg bytes / sizeof(int) of
+      them), cut into segments of at most segment bytes; element 0 is the header and
+      holds the symbol
+    - a node reacts to the symbol as soon as the header segment arrives, then keeps
+      receiving and forwarding the rest of the payload
+    - since downstream nodes depend on it, a node in its final state keeps forwarding;
+      it ACKs ROOT on ctrl_comm (as in Example 9)
+    - when ROOT has received num_nodes-1 ACKs, it sends a SHUTDOWN header (without
+      the tail segments) down the path and everyone shuts down
+    - ROOT reports elapsed time and payload bandwidth, e.g. to benchmark payloads
+      from 400 B to 64 MiB:
+
+        for b in 400 4096 65536 1048576 16777216 67108864; do
+          mpirun -np 8 ./mpi-fsm-10 $b 65536 tree
+        done
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;          // root node
+#define _MSG_BYTES 400;   // default payload size, the same 100 ints as in Example 4
+#define _SEG_BYTES 65536; // default segment size
+#define CTRL_SIZE 2       // control messages are always {type, state of the sender}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A        =  0,
+  B        =  1,
+  C        =  2,
+  ACK      =  3,
+  SHUTDOWN =  4,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+// enum dissemination paths
+enum {
+  CHAIN = 0, // 0 -> 1 -> 2 -> ... -> num_nodes-1
+  TREE  = 1, // binary tree, children of r are 2r+1 and 2r+2
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int get_parent (int rank, int path) {
+  return (CHAIN == path) ? rank-1 : (rank-1)/2;
+}
+
+// fills children with the ranks rank forwards to, returns how many there are
+int get_children (int rank, int path, int num_nodes, int *children) {
+  int n = 0;
+  if (CHAIN == path) {
+    if (rank+1 < num_nodes) children[n++] = rank+1;
+  } else {
+    if (2*rank+1 < num_nodes) children[n++] = 2*rank+1;
+    if (2*rank+2 < num_nodes) children[n++] = 2*rank+2;
+  }
+  return n;
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  long MSG_BYTES=_MSG_BYTES;
+  long SEG_BYTES=_SEG_BYTES;
+  int PATH=TREE;
+  int i,s,source,my_rank,num_nodes,my_state,symbol;
+  int parent,num_children,children[2];
+  long msg_size,seg_size,num_segs,num_msgs=0;
+  double t_start,t_end;
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols and their payloads
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs; never waits behind a payload
+
+  if (argc > 1) MSG_BYTES = atol(argv[1]);
+  if (argc > 2) SEG_BYTES = atol(argv[2]);
+  if (argc > 3) PATH = (0 == strcmp(argv[3],"chain")) ? CHAIN : TREE;
+  msg_size = (MSG_BYTES < (long)sizeof(int)) ? 1 : MSG_BYTES/(long)sizeof(int);
+  seg_size = (SEG_BYTES < (long)sizeof(int)) ? 1 : SEG_BYTES/(long)sizeof(int);
+  if (seg_size > msg_size) seg_size = msg_size;
+  num_segs = (msg_size + seg_size - 1) / seg_size;
+
+  int *msg = malloc(msg_size*sizeof(int)); // far too big for the stack in general
+  MPI_Request *reqs = malloc(2*num_segs*sizeof(MPI_Request));
+  if (NULL == msg || NULL == reqs) {
+    fprintf(stderr,"Node %d could not allocate a %ld byte payload\n",my_rank,msg_size*(long)sizeof(int));
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  memset(msg,0xff,msg_size*sizeof(int)); // the tail of the payload is just ballast
+  int ctrl[CTRL_SIZE];
+
+  parent = get_parent(my_rank,PATH);
+  num_children = get_children(my_rank,PATH,num_nodes,children);
+
+  int done = 0;
+  int flag = 0;
+  int nreqs = 0;
+  MPI_Barrier(MPI_COMM_WORLD);
+  t_start = MPI_Wtime();
+  if (ROOT == my_rank) {
+    my_state = R0;
+    while (1) {
+      msg[0] = (done) ? SHUTDOWN : get_random_msg();
+      // push every segment to the children; they start forwarding before the tail has left
+      nreqs = 0;
+      for (s=0;s<num_segs;s++) {
+        for (i=0;i<num_children;i++)
+            MPI_Isend(msg+s*seg_size,(s == num_segs-1) ? msg_size-s*seg_size : seg_size,
+                      MPI_INT,children[i],0,data_comm,&reqs[nreqs++]);
+        if (done) break; // SHUTDOWN is a header only
+      }
+      MPI_Waitall(nreqs,reqs,MPI_STATUSES_IGNORE);
+      ++num_msgs;
+      if (done)
+          break;
+      // check for ACKs, only ever on the control channel
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes in FINAL state
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,source,0,ctrl_comm,&status);
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    }
+    t_end = MPI_Wtime();
+    printf("%s: %ld byte msgs in %ld segments, %ld msgs, %.6f s, %.2f MB/s per node\n",
+           (CHAIN == PATH) ? "chain" : "tree",msg_size*(long)sizeof(int),num_segs,num_msgs,t_end-t_start,
+           (num_msgs-1)*msg_size*sizeof(int)/(t_end-t_start)/1.0e6);
+  } else {
+    my_state = Q0;
+    symbol = -1;
+    while (SHUTDOWN != symbol) {
+      nreqs = 0;
+      for (s=0;s<num_segs;s++) {
+        MPI_Recv(msg+s*seg_size,(s == num_segs-1) ? msg_size-s*seg_size : seg_size,
+                 MPI_INT,parent,0,data_comm,&status);
+        for (i=0;i<num_children;i++)
+            MPI_Isend(msg+s*seg_size,(s == num_segs-1) ? msg_size-s*seg_size : seg_size,
+                      MPI_INT,children[i],0,data_comm,&reqs[nreqs++]);
+        if (0 != s)
+            continue;
+        // the header is in; react based on msg without waiting for the tail
+        symbol = msg[0];
+        if (SHUTDOWN == symbol)
+            break;
+        switch (symbol) {
+          case A:
+            if (Q0 == my_state) {
+                my_state = next_state_proc(my_state,symbol);
+                printf("Node %d now in state %d\n",my_rank,my_state);
+            }
+            break;
+          case B:
+            if (Q1 == my_state) {
+                my_state = next_state_proc(my_state,symbol);
+                printf("Node %d now in state %d\n",my_rank,my_state);
+            }
+            break;
+          case C:
+            if (Q2 == my_state) {
+                my_state = next_state_proc(my_state,symbol);
+                printf("Node %d now in FINAL state %d (still forwarding...)\n",my_rank,my_state);
+                ctrl[0] = ACK;
+                ctrl[1] = my_state;
+                MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // small, so never stuck behind a payload
+            }
+            break;
+        }
+      }
+      MPI_Waitall(nreqs,reqs,MPI_STATUSES_IGNORE); // msg is about to be overwritten
+    }
+  }
+
+  free(reqs);
+  free(msg);
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,268 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 11 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to show how to send payloads with more than
+   2^31 elements.  In Example 4 the payload is a stack array of int MSG_SIZE elements,
+   so the stack runs out long before the int count of MPI_Send does.  Here the payload
+   lives on the heap with a controlled alignment and its size is an MPI_Count.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-11 [msg elements] [chunk elements]
+    - the payload is allocated with posix_memalign() on an _MSG_ALIGN byte boundary
+    - with an MPI-4 library, payloads are moved with MPI_Send_c/MPI_Recv_c, which
+      take an MPI_Count
+    - otherwise a derived datatype is built once at startup that describes the whole
+      payload as (msg elements / chunk elements) contiguous chunks plus the remainder,
+      and exactly one element of it is sent; every count handed to MPI fits in an int
+    - only the header (element 0) changes from message to message; rewriting
+      gigabytes for every symbol would swamp what is being measured
+    - data and control traffic are kept apart as in Example 9
+    - ROOT answers each ACK with a STOP payload (header < 0) on the data channel; a
+      node keeps receiving, and discarding, payloads until the STOP arrives, so a
+      blocking send of a payload too big to go eagerly always has a receiver
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;                  // root node
+#define _MSG_SIZE 100;            // default number of ints in a payload
+#define _MSG_ALIGN 4096;          // payload alignment in bytes (a page)
+#define _CHUNK_SIZE 1073741824;   // ints per chunk of the derived datatype (2^30)
+#define CTRL_SIZE 2               // control messages are always {type, state of the sender}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Large count payloads
+   ^^^^^^^^^^^^^^^^^^^^
+   payload_type describes an entire payload of msg_size ints; send_payload() and
+   recv_payload() always move exactly one whole payload.
+*/
+
+#if MPI_VERSION >= 4
+MPI_Count payload_count;
+
+void build_payload_type (MPI_Count msg_size, MPI_Count chunk_size) {
+  (void)chunk_size; // MPI_Send_c takes the count as is
+  payload_count = msg_size;
+}
+
+void free_payload_type (void) {
+}
+
+void send_payload (int *msg, int dest, MPI_Comm comm) {
+  MPI_Send_c(msg,payload_count,MPI_INT,dest,0,comm);
+}
+
+void recv_payload (int *msg, int source, MPI_Comm comm, MPI_Status *status) {
+  MPI_Recv_c(msg,payload_count,MPI_INT,source,0,comm,status);
+}
+#else
+MPI_Datatype payload_type;
+
+void build_payload_type (MPI_Count msg_size, MPI_Count chunk_size) {
+  MPI_Count num_chunks = msg_size / chunk_size;
+  MPI_Count remainder = msg_size % chunk_size;
+  MPI_Datatype chunk, chunks, parts[2];
+  MPI_Aint displs[2];
+  int blocklens[2] = {1,1};
+
+  if (0 == num_chunks) {
+    MPI_Type_contiguous((int)remainder,MPI_INT,&payload_type);
+  } else {
+    MPI_Type_contiguous((int)chunk_size,MPI_INT,&chunk);
+    MPI_Type_contiguous((int)num_chunks,chunk,&chunks);
+    MPI_Type_free(&chunk);
+    if (0 == remainder) {
+      payload_type = chunks;
+    } else {
+      // chunks followed by the ints that did not make up a whole chunk
+      MPI_Type_contiguous((int)remainder,MPI_INT,&parts[1]);
+      parts[0] = chunks;
+      displs[0] = 0;
+      displs[1] = (MPI_Aint)(num_chunks*chunk_size*sizeof(int));
+      MPI_Type_create_struct(2,blocklens,displs,parts,&payload_type);
+      MPI_Type_free(&parts[0]);
+      MPI_Type_free(&parts[1]);
+    }
+  }
+  MPI_Type_commit(&payload_type);
+}
+
+void free_payload_type (void) {
+  MPI_Type_free(&payload_type);
+}
+
+void send_payload (int *msg, int dest, MPI_Comm comm) {
+  MPI_Send(msg,1,payload_type,dest,0,comm);
+}
+
+void recv_payload (int *msg, int source, MPI_Comm comm, MPI_Status *status) {
+  MPI_Recv(msg,1,payload_type,source,0,comm,status);
+}
+#endif
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  MPI_Count MSG_SIZE = _MSG_SIZE;
+  MPI_Count CHUNK_SIZE = _CHUNK_SIZE;
+  size_t MSG_ALIGN = _MSG_ALIGN;
+  MPI_Count i;
+  int j,source,my_rank,num_nodes,my_state;
+  int *msg = NULL;
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols and their payloads
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs; never waits behind a payload
+
+  if (argc > 1) MSG_SIZE = strtoll(argv[1],NULL,0);
+  if (argc > 2) CHUNK_SIZE = strtoll(argv[2],NULL,0);
+  if (MSG_SIZE < 1 || CHUNK_SIZE < 1 || CHUNK_SIZE > 2147483647 || MSG_SIZE/CHUNK_SIZE > 2147483647) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"bad payload (%lld) or chunk (%lld) size\n",(long long)MSG_SIZE,(long long)CHUNK_SIZE);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  if (0 != posix_memalign((void **)&msg,MSG_ALIGN,(size_t)MSG_SIZE*sizeof(int))) {
+    fprintf(stderr,"Node %d could not allocate a %lld byte payload\n",my_rank,(long long)MSG_SIZE*(long long)sizeof(int));
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  for (i=0;i<MSG_SIZE;i++) msg[i] = -1; //build msg, touching every page once
+  build_payload_type(MSG_SIZE,CHUNK_SIZE);
+  if (ROOT == my_rank)
+      printf("ROOT sending %lld byte payloads\n",(long long)MSG_SIZE*(long long)sizeof(int));
+
+  int ctrl[CTRL_SIZE];
+  int acked[num_nodes];
+    for (j=0;j<num_nodes;j++) acked[j] = 0;
+
+  int done = 0;
+  int flag = 0;
+  if (ROOT == my_rank) {
+    my_state = R0;
+    while (!done) {
+      msg[0] = get_random_msg(); // only the header changes
+      // send msg to nodes that are still listening
+      for (j=1;j<num_nodes;j++)
+          if (!acked[j])
+              send_payload(msg,j,data_comm); // blocking send, not ideal for efficiency
+      // check for ACKs, only ever on the control channel
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes in FINAL state
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,source,0,ctrl_comm,&status);
+          acked[source] = 1;
+          msg[0] = -1;
+          send_payload(msg,source,data_comm); // STOP
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    }
+  } else {
+    my_state = Q0;
+    while (1) {
+      recv_payload(msg,ROOT,data_comm,&status);
+      if (msg[0] < 0)
+          break; // STOP
+      if (done)
+          continue; // ACKed already, waiting for STOP
+      // react based on msg
+      switch (msg[0]) {
+        case A:
+          if (Q0 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              printf("Node %d now in state %d\n",my_rank,my_state);
+          }
+          break;
+        case B:
+          if (Q1 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              printf("Node %d now in state %d\n",my_rank,my_state);
+          }
+          break;
+        case C:
+          if (Q2 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              printf("Node %d now in FINAL state %d (shutting down...)\n",my_rank,my_state);
+              ctrl[0] = ACK;
+              ctrl[1] = my_state;
+              MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // blocking send, not ideal for efficiency
+              ++done;
+          }
+          break;
+      }
+    }
+  }
+
+  free_payload_type();
+  free(msg);
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,293 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 12 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to measure how long it takes from ROOT emitting
+   a symbol to a node applying the transition for it, and to look at the whole
+   distribution of that latency rather than at an average.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-12 [number of batches]
+    - at startup each non-root process estimates the offset between its clock and
+      ROOT's with _SYNC_ROUNDS ping-pongs on ctrl_comm, keeping the sample with the
+      shortest round trip
+    - ROOT sends batches of BATCH_SIZE RANDOM symbols, each stamped with MPI_Wtime()
+      just before it is sent, then an empty batch to mark the end of the stream
+    - every time a node applies a transition it records (its clock + offset - stamp)
+      in a log-linear histogram: values below 2^LAT_SUB_BITS ns are counted exactly,
+      above that each power of two is split into 2^(LAT_SUB_BITS-1) buckets, so the
+      relative error is bounded and the memory use is fixed
+    - so that there are enough samples, a node that reaches its final state starts
+      over from its start state instead of shutting down
+    - at the end, the histograms are merged onto ROOT by MPI_Reduce with a custom
+      MPI_Op, and ROOT prints p50/p99/p99.9/max
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;            // root node
+#define _NUM_BATCHES 10000; // batches ROOT sends before ending the stream
+#define _SYNC_ROUNDS 16;    // ping-pongs used to estimate each node's clock offset
+#define BATCH_SIZE 8        // symbols per batch; fixed, since it sizes struct batch
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Latency histograms
+   ^^^^^^^^^^^^^^^^^^
+   A histogram is LAT_BUCKETS counters followed by the total count and the largest
+   value seen, all uint64_t nanoseconds, so that the whole thing can be described
+   by one MPI datatype and merged by one MPI_Op.
+*/
+
+#define LAT_SUB_BITS 7                                   // 2^(LAT_SUB_BITS-1) buckets per power of two
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_HALF (LAT_SUB / 2)
+#define LAT_MAX_SHIFT 40                                 // anything above ~2^47 ns lands in the last bucket
+#define LAT_BUCKETS (LAT_SUB + LAT_MAX_SHIFT * LAT_HALF)
+#define LAT_COUNT LAT_BUCKETS                            // index of the total count
+#define LAT_MAX (LAT_BUCKETS + 1)                        // index of the largest value
+#define LAT_SIZE (LAT_BUCKETS + 2)
+
+int get_bucket (uint64_t value) {
+  int shift;
+  if (value < LAT_SUB)
+      return (int)value;
+  shift = 63 - __builtin_clzll(value) - (LAT_SUB_BITS - 1);
+  if (shift > LAT_MAX_SHIFT)
+      return LAT_BUCKETS - 1;
+  return LAT_SUB + (shift - 1) * LAT_HALF + (int)(value >> shift) - LAT_HALF;
+}
+
+// largest value that lands in the given bucket
+uint64_t get_bucket_value (int bucket) {
+  int shift;
+  uint64_t sub;
+  if (bucket < LAT_SUB)
+      return (uint64_t)bucket;
+  shift = (bucket - LAT_SUB) / LAT_HALF + 1;
+  sub = (uint64_t)((bucket - LAT_SUB) % LAT_HALF + LAT_HALF);
+  return ((sub + 1) << shift) - 1;
+}
+
+void record_latency (uint64_t *hist, double seconds) {
+  uint64_t ns = (seconds > 0.0) ? (uint64_t)(seconds * 1.0e9) : 0; // clock offset error can go negative
+  ++hist[get_bucket(ns)];
+  ++hist[LAT_COUNT];
+  if (ns > hist[LAT_MAX])
+      hist[LAT_MAX] = ns;
+}
+
+uint64_t get_percentile (const uint64_t *hist, double percent) {
+  uint64_t seen = 0, target;
+  int i;
+  if (0 == hist[LAT_COUNT])
+      return 0;
+  target = (uint64_t)(percent / 100.0 * hist[LAT_COUNT]);
+  if (target < 1) target = 1;
+  for (i=0;i<LAT_BUCKETS;i++) {
+    seen += hist[i];
+    if (seen >= target)
+        return (get_bucket_value(i) < hist[LAT_MAX]) ? get_bucket_value(i) : hist[LAT_MAX];
+  }
+  return hist[LAT_MAX];
+}
+
+// MPI_User_function that merges *len histograms
+void merge_histograms (void *in, void *inout, int *len, MPI_Datatype *type) {
+  uint64_t *a = in, *b = inout;
+  int i,h;
+  (void)type;
+  for (h=0;h<*len;h++,a+=LAT_SIZE,b+=LAT_SIZE) {
+    for (i=0;i<LAT_MAX;i++) b[i] += a[i];
+    if (a[LAT_MAX] > b[LAT_MAX]) b[LAT_MAX] = a[LAT_MAX];
+  }
+}
+
+void print_histogram (const char *who, const uint64_t *hist) {
+  printf("%s: %llu transitions, latency p50 %.3f us, p99 %.3f us, p99.9 %.3f us, max %.3f us\n",who,
+         (unsigned long long)hist[LAT_COUNT],get_percentile(hist,50.0)/1.0e3,get_percentile(hist,99.0)/1.0e3,
+         get_percentile(hist,99.9)/1.0e3,hist[LAT_MAX]/1.0e3);
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  long NUM_BATCHES=_NUM_BATCHES;
+  int SYNC_ROUNDS=_SYNC_ROUNDS;
+  int i,j,k,my_rank,num_nodes,my_state,symbol;
+  long n;
+  double t0,t1,t_root,rtt,best_rtt,offset=0.0;
+  char who[32];
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Datatype hist_type;
+  MPI_Op hist_op;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // clock synchronization
+  MPI_Type_contiguous(LAT_SIZE,MPI_UINT64_T,&hist_type);
+  MPI_Type_commit(&hist_type);
+  MPI_Op_create(merge_histograms,1,&hist_op);
+
+  if (argc > 1)
+      NUM_BATCHES = atol(argv[1]);
+  if (NUM_BATCHES < 0) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [number of batches]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  // a batch is a timestamp, a count and the symbols; sent as bytes
+  struct batch {
+    double stamp;
+    int count;
+    int symbols[BATCH_SIZE];
+  } batch;
+  uint64_t *hist = calloc(LAT_SIZE,sizeof(uint64_t));
+  uint64_t *merged = calloc(LAT_SIZE,sizeof(uint64_t));
+  if (NULL == hist || NULL == merged) {
+    fprintf(stderr,"Node %d could not allocate its histogram\n",my_rank);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+
+  // estimate the offset between each node's clock and ROOT's, one node at a time
+  if (ROOT == my_rank) {
+    for (j=1;j<num_nodes;j++)
+      for (k=0;k<SYNC_ROUNDS;k++) {
+        MPI_Recv(&t0,1,MPI_DOUBLE,j,0,ctrl_comm,&status);
+        t_root = MPI_Wtime();
+        MPI_Send(&t_root,1,MPI_DOUBLE,j,0,ctrl_comm);
+      }
+  } else {
+    best_rtt = -1.0;
+    for (k=0;k<SYNC_ROUNDS;k++) {
+      t0 = MPI_Wtime();
+      MPI_Send(&t0,1,MPI_DOUBLE,ROOT,0,ctrl_comm);
+      MPI_Recv(&t_root,1,MPI_DOUBLE,ROOT,0,ctrl_comm,&status);
+      t1 = MPI_Wtime();
+      rtt = t1 - t0;
+      if (best_rtt < 0.0 || rtt < best_rtt) { // the shortest round trip is the least skewed
+        best_rtt = rtt;
+        offset = t_root - (t0 + t1) / 2.0;
+      }
+    }
+  }
+
+  if (ROOT == my_rank) {
+    my_state = R0;
+    for (n=0;n<=NUM_BATCHES;n++) {
+      batch.count = (n < NUM_BATCHES) ? BATCH_SIZE : 0; // an empty batch ends the stream
+      for (i=0;i<batch.count;i++) batch.symbols[i] = get_random_msg();
+      for (j=1;j<num_nodes;j++) {
+        batch.stamp = MPI_Wtime();
+        MPI_Send(&batch,sizeof(batch),MPI_BYTE,j,0,data_comm); // blocking send, not ideal for efficiency
+      }
+    }
+  } else {
+    my_state = Q0;
+    do {
+      MPI_Recv(&batch,sizeof(batch),MPI_BYTE,ROOT,0,data_comm,&status);
+      // react based on each msg in the batch
+      for (i=0;i<batch.count;i++) {
+        symbol = batch.symbols[i];
+        switch (symbol) {
+          case A:
+            if (Q0 == my_state) {
+                my_state = next_state_proc(my_state,symbol);
+                record_latency(hist,MPI_Wtime() + offset - batch.stamp);
+            }
+            break;
+          case B:
+            if (Q1 == my_state) {
+                my_state = next_state_proc(my_state,symbol);
+                record_latency(hist,MPI_Wtime() + offset - batch.stamp);
+            }
+            break;
+          case C:
+            if (Q2 == my_state) {
+                my_state = next_state_proc(my_state,symbol);
+                record_latency(hist,MPI_Wtime() + offset - batch.stamp);
+                my_state = Q0; // start over to keep the samples coming
+            }
+            break;
+        }
+      }
+    } while (0 != batch.count);
+    snprintf(who,sizeof(who),"Node %d",my_rank);
+    print_histogram(who,hist);
+  }
+
+  MPI_Reduce(hist,merged,1,hist_type,hist_op,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank)
+      print_histogram("ALL",merged);
+
+  free(merged);
+  free(hist);
+  MPI_Op_free(&hist_op);
+  MPI_Type_free(&hist_type);
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,283 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 13 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to show how to keep a record of every transition
+   without paying for it on every transition.  The printf() calls in the previous
+   examples format text and push it through mpirun's I/O forwarding each time a node
+   changes state, which under load costs more than everything else the node does.
+   Here each node appends a small binary record to a preallocated buffer instead, and
+   the text is only produced afterwards, by fsm-trace, if somebody wants to read it.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-13 [sessions per node]
+    - each transition is stored as a struct trace_record (time, rank, old state,
+      symbol, new state; see fsm-trace.h) in a per-rank buffer of _TRACE_CAPACITY
+      records that is allocated once
+    - when the buffer is full it is written out to fsm-trace.<rank>.bin (in
+      $FSM_TRACE_DIR, or the current directory) in one go and reused; whatever is
+      left is written at exit
+    - record times are on ROOT's clock: each node first estimates the offset between
+      its clock and ROOT's with the ping-pongs of Example 12, then ROOT broadcasts
+      when it left the start barrier; the offset is kept in the trace header
+    - so that there is some load, a node that reaches its final state starts over
+      until it has finished the requested number of sessions, and only then ACKs
+    - the traces are merged by time and printed in the familiar format with
+
+        bin/fsm-trace fsm-trace.*.bin
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mpi.h"
+#include "fsm-trace.h"
+#define _ROOT 0;                // root node
+#define _NUM_SESSIONS 1000;     // times each node has to reach its final state
+#define _TRACE_CAPACITY 65536;  // records buffered per rank between writes
+#define _SYNC_ROUNDS 16;        // ping-pongs used to estimate each node's clock offset
+#define CTRL_SIZE 2             // control messages are always {type, state of the sender}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Tracing
+   ^^^^^^^
+   trace_buf holds the records that have not been written yet; trace_transition()
+   only touches the file when the buffer fills up.
+*/
+
+struct trace_record *trace_buf;
+int trace_len, trace_capacity, trace_rank;
+double trace_start;
+FILE *trace_file;
+
+void trace_flush (void) {
+  if (trace_len > 0 && NULL != trace_file)
+      fwrite(trace_buf,sizeof(struct trace_record),trace_len,trace_file);
+  trace_len = 0;
+}
+
+// start is on ROOT's clock, offset is what this rank adds to its own to get ROOT's
+void trace_open (int rank, int capacity, double start, double offset) {
+  struct trace_header header;
+  const char *dir = getenv("FSM_TRACE_DIR");
+  char path[4096];
+
+  trace_rank = rank;
+  trace_start = start - offset; // on this rank's clock
+  trace_capacity = capacity;
+  trace_len = 0;
+  trace_buf = malloc(capacity*sizeof(struct trace_record));
+  snprintf(path,sizeof(path),"%s/fsm-trace.%d.bin",(NULL != dir) ? dir : ".",rank);
+  if (NULL == trace_buf || NULL == (trace_file = fopen(path,"wb"))) {
+    fprintf(stderr,"Node %d could not set up its trace %s\n",rank,path);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,TRACE_MAGIC,sizeof(header.magic));
+  header.rank = rank;
+  header.final_state = Q3;
+  header.clock_offset = offset;
+  fwrite(&header,sizeof(header),1,trace_file);
+}
+
+void trace_transition (int old_state, int symbol, int new_state) {
+  struct trace_record *r;
+  if (trace_len == trace_capacity)
+      trace_flush();
+  r = &trace_buf[trace_len++];
+  r->time = MPI_Wtime() - trace_start;
+  r->rank = trace_rank;
+  r->old_state = old_state;
+  r->symbol = symbol;
+  r->new_state = new_state;
+}
+
+void trace_close (void) {
+  trace_flush();
+  fclose(trace_file);
+  free(trace_buf);
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  long NUM_SESSIONS=_NUM_SESSIONS;
+  int TRACE_CAPACITY=_TRACE_CAPACITY;
+  int SYNC_ROUNDS=_SYNC_ROUNDS;
+  int j,k,source,my_rank,num_nodes,my_state,old_state;
+  double t0,t1,t_root,rtt,best_rtt,offset=0.0,start;
+  long sessions=0;
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs
+
+  if (argc > 1)
+      NUM_SESSIONS = atol(argv[1]);
+  if (NUM_SESSIONS < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [sessions per node]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  int msg = -1;
+  int ctrl[CTRL_SIZE];
+  int acked[num_nodes];
+    for (j=0;j<num_nodes;j++) acked[j] = 0;
+
+  int done = 0;
+  int flag = 0;
+  // estimate the offset between each node's clock and ROOT's, one node at a time
+  if (ROOT == my_rank) {
+    for (j=1;j<num_nodes;j++)
+      for (k=0;k<SYNC_ROUNDS;k++) {
+        MPI_Recv(&t0,1,MPI_DOUBLE,j,0,ctrl_comm,&status);
+        t_root = MPI_Wtime();
+        MPI_Send(&t_root,1,MPI_DOUBLE,j,0,ctrl_comm);
+      }
+  } else {
+    best_rtt = -1.0;
+    for (k=0;k<SYNC_ROUNDS;k++) {
+      t0 = MPI_Wtime();
+      MPI_Send(&t0,1,MPI_DOUBLE,ROOT,0,ctrl_comm);
+      MPI_Recv(&t_root,1,MPI_DOUBLE,ROOT,0,ctrl_comm,&status);
+      t1 = MPI_Wtime();
+      rtt = t1 - t0;
+      if (best_rtt < 0.0 || rtt < best_rtt) { // the shortest round trip is the least skewed
+        best_rtt = rtt;
+        offset = t_root - (t0 + t1) / 2.0;
+      }
+    }
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  start = MPI_Wtime();
+  MPI_Bcast(&start,1,MPI_DOUBLE,ROOT,MPI_COMM_WORLD); // trace times are relative to ROOT leaving the barrier
+  if (ROOT == my_rank) {
+    my_state = R0;
+    while (!done) {
+      msg = get_random_msg();
+      // send msg to nodes that are still listening
+      for (j=1;j<num_nodes;j++)
+          if (!acked[j])
+              MPI_Send(&msg,1,MPI_INT,j,0,data_comm); // blocking send, not ideal for efficiency
+      // check for ACKs, only ever on the control channel
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes that are done
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,source,0,ctrl_comm,&status);
+          acked[source] = 1;
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    }
+  } else {
+    trace_open(my_rank,TRACE_CAPACITY,start,offset);
+    my_state = Q0;
+    while (!done) {
+      MPI_Recv(&msg,1,MPI_INT,ROOT,0,data_comm,&status);
+      old_state = my_state;
+      // react based on msg
+      switch (msg) {
+        case A:
+          if (Q0 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              trace_transition(old_state,msg,my_state);
+          }
+          break;
+        case B:
+          if (Q1 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              trace_transition(old_state,msg,my_state);
+          }
+          break;
+        case C:
+          if (Q2 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              trace_transition(old_state,msg,my_state);
+              if (NUM_SESSIONS == ++sessions) {
+                ctrl[0] = ACK;
+                ctrl[1] = my_state;
+                MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // blocking send, not ideal for efficiency
+                ++done;
+              } else {
+                my_state = Q0; // start the next session
+              }
+          }
+          break;
+      }
+    }
+    trace_close();
+  }
+
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,241 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 14 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to find out which parts of the transition
+   matrix are actually used.  Every node counts, for every (state, symbol) cell of
+   DELTA_PROC, how often the transition was taken and how often the precondition
+   turned the symbol away, and how long it spent in each state.  The counts show
+   which cells are hot (and so which states should sit next to each other in memory)
+   and how many of the symbols ROOT sent were wasted.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-14 [sessions per node]
+    - each node keeps taken[state][symbol], rejected[state][symbol] and
+      time_in_state[state]
+    - so that there is some load, a node that reaches its final state starts over
+      until it has finished the requested number of sessions, and only then ACKs
+    - at the end the counters of all nodes are summed onto ROOT with MPI_Reduce, and
+      ROOT prints them as tables together with the share of rejected symbols
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;                // root node
+#define _NUM_SESSIONS 1000;     // times each node has to reach its final state
+#define CTRL_SIZE 2             // control messages are always {type, state of the sender}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Counters
+   ^^^^^^^^
+   taken and rejected are indexed by the state the node was in when the symbol
+   arrived; time_in_state is charged whenever the node leaves a state (and once more
+   at the end for the state it is left in).
+*/
+
+#define NUM_STATES 4
+long taken[NUM_STATES][NUM_SYMBOLS];
+long rejected[NUM_STATES][NUM_SYMBOLS];
+double time_in_state[NUM_STATES];
+double entered;          // when the node entered its current state
+
+// moves the node to new_state, charging the time spent in old_state
+int enter_state (int old_state, int new_state) {
+  double now = MPI_Wtime();
+  time_in_state[old_state] += now - entered;
+  entered = now;
+  return new_state;
+}
+
+void print_counts (const char *title, long counts[NUM_STATES][NUM_SYMBOLS]) {
+  int q,s;
+  printf("%s\n      %10s %10s %10s\n",title,"A","B","C");
+  for (q=0;q<NUM_STATES;q++) {
+    printf("  Q%d  ",q);
+    for (s=0;s<NUM_SYMBOLS;s++) printf(" %10ld",counts[q][s]);
+    printf("\n");
+  }
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  long NUM_SESSIONS=_NUM_SESSIONS;
+  int q,s,j,source,my_rank,num_nodes,my_state;
+  long sessions=0,sent=0,num_taken=0,num_rejected=0;
+  long sum_taken[NUM_STATES][NUM_SYMBOLS], sum_rejected[NUM_STATES][NUM_SYMBOLS];
+  double sum_time[NUM_STATES];
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs
+
+  if (argc > 1)
+      NUM_SESSIONS = atol(argv[1]);
+  if (NUM_SESSIONS < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [sessions per node]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  int msg = -1;
+  int ctrl[CTRL_SIZE];
+  int acked[num_nodes];
+    for (j=0;j<num_nodes;j++) acked[j] = 0;
+
+  int done = 0;
+  int flag = 0;
+  if (ROOT == my_rank) {
+    my_state = R0;
+    while (!done) {
+      msg = get_random_msg();
+      // send msg to nodes that are still listening
+      for (j=1;j<num_nodes;j++)
+          if (!acked[j]) {
+              MPI_Send(&msg,1,MPI_INT,j,0,data_comm); // blocking send, not ideal for efficiency
+              ++sent;
+          }
+      // check for ACKs, only ever on the control channel
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes that are done
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,source,0,ctrl_comm,&status);
+          acked[source] = 1;
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    }
+  } else {
+    my_state = Q0;
+    entered = MPI_Wtime();
+    while (!done) {
+      MPI_Recv(&msg,1,MPI_INT,ROOT,0,data_comm,&status);
+      // react based on msg
+      switch (msg) {
+        case A:
+          if (Q0 == my_state) {
+              ++taken[my_state][msg];
+              my_state = enter_state(my_state,next_state_proc(my_state,msg));
+          } else {
+              ++rejected[my_state][msg];
+          }
+          break;
+        case B:
+          if (Q1 == my_state) {
+              ++taken[my_state][msg];
+              my_state = enter_state(my_state,next_state_proc(my_state,msg));
+          } else {
+              ++rejected[my_state][msg];
+          }
+          break;
+        case C:
+          if (Q2 == my_state) {
+              ++taken[my_state][msg];
+              my_state = enter_state(my_state,next_state_proc(my_state,msg));
+              if (NUM_SESSIONS == ++sessions) {
+                ctrl[0] = ACK;
+                ctrl[1] = my_state;
+                MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // blocking send, not ideal for efficiency
+                ++done;
+              } else {
+                my_state = enter_state(my_state,Q0); // start the next session
+              }
+          } else {
+              ++rejected[my_state][msg];
+          }
+          break;
+      }
+    }
+    enter_state(my_state,my_state); // charge the state the node ends in
+  }
+
+  // ROOT's counters are all zero, so it can take part in the sums as is
+  MPI_Reduce(taken,sum_taken,NUM_STATES*NUM_SYMBOLS,MPI_LONG,MPI_SUM,ROOT,MPI_COMM_WORLD);
+  MPI_Reduce(rejected,sum_rejected,NUM_STATES*NUM_SYMBOLS,MPI_LONG,MPI_SUM,ROOT,MPI_COMM_WORLD);
+  MPI_Reduce(time_in_state,sum_time,NUM_STATES,MPI_DOUBLE,MPI_SUM,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank) {
+    print_counts("transitions taken (state the symbol arrived in x symbol)",sum_taken);
+    print_counts("symbols rejected by the precondition",sum_rejected);
+    printf("time in state (s, summed over nodes)\n");
+    for (q=0;q<NUM_STATES;q++) printf("  Q%d   %10.6f\n",q,sum_time[q]);
+    for (q=0;q<NUM_STATES;q++)
+      for (s=0;s<NUM_SYMBOLS;s++) {
+        num_taken += sum_taken[q][s];
+        num_rejected += sum_rejected[q][s];
+      }
+    printf("%ld symbols sent, %ld taken, %ld (%.1f%%) rejected, %ld still in flight at shutdown\n",sent,num_taken,
+           num_rejected,(sent > 0) ? 100.0*num_rejected/sent : 0.0,sent-num_taken-num_rejected);
+  }
+
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
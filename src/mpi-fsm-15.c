@@ -0,0 +1,323 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 15 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to find out what bounds the loop of a non-root
+   process: branch mispredictions in the precondition switch, cache misses on
+   DELTA_PROC, or waiting on MPI.  The hardware performance counters are read around
+   the receive and around the transition (the "step") separately.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-15 [sessions per node]
+    - on Linux, each node opens one perf_event_open() group of cycles, instructions,
+      branch-misses, L1d read misses and LLC misses, counting user space only
+    - any counter the kernel (or a virtual machine) will not give us is left out and
+      reported as n/a; with none at all the example still runs, it just has nothing
+      to report
+    - each node prints its own totals for the two regions; ROOT prints the sums over
+      all nodes and the counts per symbol received
+    - as in Example 14, a node starts over until it has finished the requested number
+      of sessions, and only then ACKs
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include "mpi.h"
+#define _ROOT 0;                // root node
+#define _NUM_SESSIONS 10000;    // times each node has to reach its final state
+#define CTRL_SIZE 2             // control messages are always {type, state of the sender}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Performance counters
+   ^^^^^^^^^^^^^^^^^^^^
+   All the counters that could be opened are in one group, so a single read() gives
+   a consistent snapshot of all of them.  region_begin() takes a snapshot and
+   region_end() adds the difference to the totals of the region.
+*/
+
+#define NUM_COUNTERS 5
+enum {
+  REGION_RECV = 0,
+  REGION_STEP = 1,
+  NUM_REGIONS
+};
+
+const char *COUNTER_NAMES[NUM_COUNTERS] = {"cycles","instructions","branch-misses","L1d-misses","LLC-misses"};
+const char *REGION_NAMES[NUM_REGIONS] = {"recv","step"};
+
+int counter_fd[NUM_COUNTERS];       // -1 if the counter is not available
+int counter_slot[NUM_COUNTERS];     // position of the counter in a group read
+int counter_leader = -1;
+uint64_t counter_snapshot[NUM_COUNTERS];
+uint64_t region_counts[NUM_REGIONS][NUM_COUNTERS];
+
+// returns the number of counters that could be opened; why is set to the first error
+int counters_open (int *why) {
+  int c,num_open=0;
+  *why = 0;
+  for (c=0;c<NUM_COUNTERS;c++) counter_fd[c] = -1;
+#ifdef __linux__
+  struct perf_event_attr attr;
+  uint64_t configs[NUM_COUNTERS][2] = {
+    {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE,PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE,PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE,PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CACHE_MISSES},
+  };
+  for (c=0;c<NUM_COUNTERS;c++) {
+    memset(&attr,0,sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = (uint32_t)configs[c][0];
+    attr.config = configs[c][1];
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled = (counter_leader < 0);  // the group starts when its leader is enabled
+    attr.exclude_kernel = 1;               // allowed at the default perf_event_paranoid
+    attr.exclude_hv = 1;
+    counter_fd[c] = syscall(__NR_perf_event_open,&attr,0,-1,counter_leader,0);
+    if (counter_fd[c] < 0) {
+      if (0 == *why) *why = errno;
+      counter_fd[c] = -1;
+      continue;
+    }
+    if (counter_leader < 0)
+        counter_leader = counter_fd[c];
+    counter_slot[c] = num_open++;
+  }
+  if (counter_leader >= 0) {
+    ioctl(counter_leader,PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+    ioctl(counter_leader,PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+  }
+#else
+  *why = ENOSYS;
+#endif
+  return num_open;
+}
+
+void counters_close (void) {
+  int c;
+  for (c=0;c<NUM_COUNTERS;c++)
+      if (counter_fd[c] >= 0)
+          close(counter_fd[c]);
+}
+
+void counters_read (uint64_t *values) {
+  uint64_t buf[1+NUM_COUNTERS]; // {number of counters, values...}
+  int c;
+  if (counter_leader < 0 || read(counter_leader,buf,sizeof(buf)) <= 0)
+      return;
+  for (c=0;c<NUM_COUNTERS;c++)
+      if (counter_fd[c] >= 0)
+          values[c] = buf[1+counter_slot[c]];
+}
+
+void region_begin (void) {
+  counters_read(counter_snapshot);
+}
+
+void region_end (int region) {
+  uint64_t now[NUM_COUNTERS];
+  int c;
+  memcpy(now,counter_snapshot,sizeof(now));
+  counters_read(now);
+  for (c=0;c<NUM_COUNTERS;c++)
+      region_counts[region][c] += now[c] - counter_snapshot[c];
+}
+
+void print_counts (const char *who, uint64_t counts[NUM_REGIONS][NUM_COUNTERS], const int *available, double per) {
+  int r,c;
+  for (r=0;r<NUM_REGIONS;r++) {
+    printf("%s %s:",who,REGION_NAMES[r]);
+    for (c=0;c<NUM_COUNTERS;c++) {
+      if (!available[c])
+          printf(" %s n/a",COUNTER_NAMES[c]);
+      else if (per > 0.0)
+          printf(" %s %.2f",COUNTER_NAMES[c],counts[r][c]/per);
+      else
+          printf(" %s %llu",COUNTER_NAMES[c],(unsigned long long)counts[r][c]);
+    }
+    printf("\n");
+  }
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  long NUM_SESSIONS=_NUM_SESSIONS;
+  int c,j,source,my_rank,num_nodes,my_state,why;
+  long sessions=0,received=0,sum_received=0;
+  int available[NUM_COUNTERS],all_available[NUM_COUNTERS];
+  uint64_t sums[NUM_REGIONS][NUM_COUNTERS];
+  char who[32];
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs
+
+  if (argc > 1)
+      NUM_SESSIONS = atol(argv[1]);
+  if (NUM_SESSIONS < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [sessions per node]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  int msg = -1;
+  int ctrl[CTRL_SIZE];
+  int acked[num_nodes];
+    for (j=0;j<num_nodes;j++) acked[j] = 0;
+
+  int done = 0;
+  int flag = 0;
+  if (ROOT == my_rank) {
+    my_state = R0;
+    for (c=0;c<NUM_COUNTERS;c++) available[c] = 1; // ROOT counts nothing, so it must not veto anything
+    while (!done) {
+      msg = get_random_msg();
+      // send msg to nodes that are still listening
+      for (j=1;j<num_nodes;j++)
+          if (!acked[j])
+              MPI_Send(&msg,1,MPI_INT,j,0,data_comm); // blocking send, not ideal for efficiency
+      // check for ACKs, only ever on the control channel
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes that are done
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,source,0,ctrl_comm,&status);
+          acked[source] = 1;
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    }
+  } else {
+    if (0 == counters_open(&why))
+        fprintf(stderr,"Node %d has no performance counters (%s), reporting n/a\n",my_rank,strerror(why));
+    for (c=0;c<NUM_COUNTERS;c++) available[c] = (counter_fd[c] >= 0);
+    my_state = Q0;
+    while (!done) {
+      region_begin();
+      MPI_Recv(&msg,1,MPI_INT,ROOT,0,data_comm,&status);
+      region_end(REGION_RECV);
+      ++received;
+      // react based on msg
+      region_begin();
+      switch (msg) {
+        case A:
+          if (Q0 == my_state)
+              my_state = next_state_proc(my_state,msg);
+          break;
+        case B:
+          if (Q1 == my_state)
+              my_state = next_state_proc(my_state,msg);
+          break;
+        case C:
+          if (Q2 == my_state)
+              my_state = next_state_proc(my_state,msg);
+          break;
+      }
+      region_end(REGION_STEP);
+      if (Q3 == my_state) {
+        if (NUM_SESSIONS == ++sessions) {
+          ctrl[0] = ACK;
+          ctrl[1] = my_state;
+          MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // blocking send, not ideal for efficiency
+          ++done;
+        } else {
+          my_state = Q0; // start the next session
+        }
+      }
+    }
+    counters_close();
+    snprintf(who,sizeof(who),"Node %d",my_rank);
+    print_counts(who,region_counts,available,0.0);
+  }
+
+  // ROOT's counts are all zero, so it can take part in the sums as is
+  MPI_Reduce(region_counts,sums,NUM_REGIONS*NUM_COUNTERS,MPI_UINT64_T,MPI_SUM,ROOT,MPI_COMM_WORLD);
+  MPI_Reduce(available,all_available,NUM_COUNTERS,MPI_INT,MPI_MIN,ROOT,MPI_COMM_WORLD);
+  MPI_Reduce(&received,&sum_received,1,MPI_LONG,MPI_SUM,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank) {
+    print_counts("ALL",sums,all_available,0.0);
+    printf("%ld symbols received; per symbol:\n",sum_received);
+    if (sum_received > 0)
+        print_counts("ALL",sums,all_available,(double)sum_received);
+  }
+
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,313 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 16 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to find out where the wall time goes before
+   trying to make anything faster.  Every rank splits its time into a few categories
+   and reports the split, both while it runs and at the end.  Non-root processes
+   account for the time blocked in MPI_Recv, stepping the FSM, handling the payload
+   and logging; ROOT for generating symbols, sending them and probing for ACKs.
+
+   Reading the end-of-run table:
+    - nodes mostly in recv while ROOT is mostly in send: the run is communication
+      bound.  If ROOT's us per send hardly changes with the message size it is
+      latency bound, if its MB/s while sending stays flat it is bandwidth bound
+    - nodes mostly in step/payload and ROOT mostly in probe: compute bound, the nodes
+      cannot keep up with ROOT
+    - a lot of log: the printf() calls are the bottleneck (see Example 13)
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-16 [sessions per node] [message size] [snapshot interval (s)]
+    - the layout is that of Example 9 (data_comm for symbols and payloads, ctrl_comm
+      for ACKs), with an _MSG_SIZE integer payload that a node checksums on receipt
+    - so that there is some load, a node that reaches its final state starts over
+      until it has finished the requested number of sessions, and only then ACKs
+    - ROOT answers each ACK with a STOP message (first element < 0) on data_comm; the
+      node keeps receiving, and discarding, messages until the STOP arrives, so a
+      blocking send of a message too big to go eagerly always has a receiver
+    - every rank keeps its categories in time_acct[], charged back to back so that
+      they add up to (nearly) the elapsed time; whatever is left is "other"
+    - every _SNAPSHOT_INTERVAL seconds each rank prints its split so far to stderr
+    - at the end the splits are gathered onto ROOT, which prints them as a table
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;                  // root node
+#define _NUM_SESSIONS 100;        // times each node has to reach its final state
+#define _MSG_SIZE 1024;           // msg is an array of _MSG_SIZE elements, the first one is the symbol
+#define _SNAPSHOT_INTERVAL 1.0;   // seconds between snapshots
+#define CTRL_SIZE 2               // control messages are always {type, state of the sender}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Time accounting
+   ^^^^^^^^^^^^^^^
+   charge() adds the time since the last charge to one category and restarts the
+   clock, so consecutive charges cover the loop without gaps.  The categories share
+   time_acct[]; ROOT uses the first three, the nodes all four.
+*/
+
+#define NUM_ACCT 4
+enum {
+  RECV_TIME    = 0, // nodes
+  STEP_TIME    = 1,
+  PAYLOAD_TIME = 2,
+  LOG_TIME     = 3,
+  GEN_TIME     = 0, // ROOT
+  SEND_TIME    = 1,
+  PROBE_TIME   = 2,
+};
+const char *NODE_ACCT_NAMES[NUM_ACCT] = {"recv","step","payload","log"};
+const char *ROOT_ACCT_NAMES[NUM_ACCT] = {"gen","send","probe",NULL};
+
+#define REPORT_SIZE (NUM_ACCT+2)  // time_acct[], other, elapsed
+double time_acct[NUM_ACCT];
+double last_charge, start;
+
+void charge (int category) {
+  double now = MPI_Wtime();
+  time_acct[category] += now - last_charge;
+  last_charge = now;
+}
+
+void print_split (FILE *out, int rank, const char **names, const double *report) {
+  int k;
+  double elapsed = report[NUM_ACCT+1];
+  fprintf(out,"%5d %-4s %10.4f",rank,(names == ROOT_ACCT_NAMES) ? "root" : "node",elapsed);
+  for (k=0;k<NUM_ACCT;k++)
+    if (NULL != names[k])
+        fprintf(out,"  %s %8.4f %5.1f%%",names[k],report[k],(elapsed > 0.0) ? 100.0*report[k]/elapsed : 0.0);
+  fprintf(out,"  other %8.4f %5.1f%%\n",report[NUM_ACCT],(elapsed > 0.0) ? 100.0*report[NUM_ACCT]/elapsed : 0.0);
+}
+
+void fill_report (double *report) {
+  int k;
+  double other = last_charge - start;
+  for (k=0;k<NUM_ACCT;k++) {
+    report[k] = time_acct[k];
+    other -= time_acct[k];
+  }
+  report[NUM_ACCT] = (other > 0.0) ? other : 0.0; // rounding
+  report[NUM_ACCT+1] = last_charge - start;
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+long checksum;  // what a node makes of the payloads; global, so the loop is not optimized away
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  long NUM_SESSIONS=_NUM_SESSIONS;
+  int MSG_SIZE=_MSG_SIZE;
+  double SNAPSHOT_INTERVAL=_SNAPSHOT_INTERVAL;
+  int i,j,source,my_rank,num_nodes,my_state,tmpmsg;
+  long sessions=0,sends=0;
+  double next_snapshot,report[REPORT_SIZE];
+  const char **names;
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols and their payloads
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs; never waits behind a payload
+
+  if (argc > 1)
+      NUM_SESSIONS = atol(argv[1]);
+  if (argc > 2)
+      MSG_SIZE = atoi(argv[2]);
+  if (argc > 3)
+      SNAPSHOT_INTERVAL = atof(argv[3]);
+  if (NUM_SESSIONS < 1 || MSG_SIZE < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [sessions per node] [message size] [snapshot interval (s)]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  int *msg = malloc(MSG_SIZE*sizeof(int));
+  if (NULL == msg) {
+    fprintf(stderr,"Node %d could not allocate a %ld byte message\n",my_rank,MSG_SIZE*(long)sizeof(int));
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+    for (i=0;i<MSG_SIZE;i++) msg[i] = -1; //build msg
+  int ctrl[CTRL_SIZE];
+  int acked[num_nodes];
+    for (j=0;j<num_nodes;j++) acked[j] = 0;
+
+  int done = 0;
+  int flag = 0;
+  names = (ROOT == my_rank) ? ROOT_ACCT_NAMES : NODE_ACCT_NAMES;
+  MPI_Barrier(MPI_COMM_WORLD);
+  start = last_charge = MPI_Wtime();
+  next_snapshot = start + SNAPSHOT_INTERVAL;
+  if (ROOT == my_rank) {
+    my_state = R0;
+    while (!done) {
+      tmpmsg = get_random_msg();
+        for (i=0;i<MSG_SIZE;i++) msg[i] = tmpmsg; //build msg
+      charge(GEN_TIME);
+      // send msg to nodes that are still listening
+      for (j=1;j<num_nodes;j++)
+          if (!acked[j]) {
+              MPI_Send(msg,MSG_SIZE,MPI_INT,j,0,data_comm); // blocking send, not ideal for efficiency
+              ++sends;
+          }
+      charge(SEND_TIME);
+      // check for ACKs, only ever on the control channel
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes that are done
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,source,0,ctrl_comm,&status);
+          acked[source] = 1;
+          msg[0] = -1;
+          MPI_Send(msg,MSG_SIZE,MPI_INT,source,0,data_comm); // STOP
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+      charge(PROBE_TIME);
+      if (last_charge >= next_snapshot) {
+        fill_report(report);
+        print_split(stderr,my_rank,names,report);
+        next_snapshot += SNAPSHOT_INTERVAL;
+        last_charge = MPI_Wtime(); // the snapshot itself is "other"
+      }
+    }
+  } else {
+    my_state = Q0;
+    while (1) {
+      MPI_Recv(msg,MSG_SIZE,MPI_INT,ROOT,0,data_comm,&status);
+      charge(RECV_TIME);
+      if (msg[0] < 0)
+          break; // STOP
+      if (done)
+          continue; // ACKed already, waiting for STOP
+      for (i=1;i<MSG_SIZE;i++) checksum += msg[i]; // "handle" the payload
+      charge(PAYLOAD_TIME);
+      // react based on msg
+      switch (msg[0]) {
+        case A:
+          if (Q0 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              charge(STEP_TIME);
+              printf("Node %d now in state %d\n",my_rank,my_state);
+              charge(LOG_TIME);
+          }
+          break;
+        case B:
+          if (Q1 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              charge(STEP_TIME);
+              printf("Node %d now in state %d\n",my_rank,my_state);
+              charge(LOG_TIME);
+          }
+          break;
+        case C:
+          if (Q2 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              charge(STEP_TIME);
+              printf("Node %d now in FINAL state %d\n",my_rank,my_state);
+              charge(LOG_TIME);
+              if (NUM_SESSIONS == ++sessions) {
+                ctrl[0] = ACK;
+                ctrl[1] = my_state;
+                MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // blocking send, not ideal for efficiency
+                ++done;
+              } else {
+                my_state = Q0; // start the next session
+              }
+          }
+          break;
+      }
+      charge(STEP_TIME); // rejected symbols and the ACK count as stepping too
+      if (last_charge >= next_snapshot) {
+        fill_report(report);
+        print_split(stderr,my_rank,names,report);
+        next_snapshot += SNAPSHOT_INTERVAL;
+        charge(LOG_TIME);
+      }
+    }
+  }
+  fill_report(report);
+
+  double *reports = (ROOT == my_rank) ? malloc(num_nodes*REPORT_SIZE*sizeof(double)) : NULL;
+  MPI_Gather(report,REPORT_SIZE,MPI_DOUBLE,reports,REPORT_SIZE,MPI_DOUBLE,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank) {
+    fflush(stdout);
+    printf("\n rank role    elapsed  time per category (s, share of elapsed)\n");
+    for (j=0;j<num_nodes;j++)
+        print_split(stdout,j,(ROOT == j) ? ROOT_ACCT_NAMES : NODE_ACCT_NAMES,&reports[j*REPORT_SIZE]);
+    printf("ROOT: %ld sends of %ld bytes, %.2f us per send, %.1f MB/s while sending\n",sends,
+           MSG_SIZE*(long)sizeof(int),(sends > 0) ? 1.0e6*time_acct[SEND_TIME]/sends : 0.0,
+           (time_acct[SEND_TIME] > 0.0) ? sends*MSG_SIZE*sizeof(int)/time_acct[SEND_TIME]/1.0e6 : 0.0);
+    free(reports);
+  }
+
+  free(msg);
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
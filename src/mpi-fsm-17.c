@@ -0,0 +1,313 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 17 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to watch a long run while it is running,
+   without printf() on every transition and without slowing it down.  Every
+   _METRICS_INTERVAL rounds each rank hands a small struct metrics to MPI_Ireduce and
+   carries on; ROOT tests for the result between rounds and, when it is there, appends
+   one line to a time series that an operator can follow with tail -f (or read from a
+   unix socket).  Nobody ever waits for the reduction unless the previous one is
+   still outstanding when the next is due.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-17 [rounds] [metrics output]
+    - ROOT sends one RANDOM symbol per round to every node for the given number of
+      rounds, then END; a node that reaches its final state starts over
+    - the metrics are sent to the output named on the command line, else in
+      $FSM_METRICS, else fsm-metrics.csv; "unix:/path" connects to a unix socket
+      instead, and samples that the collector is not ready for are dropped rather
+      than holding up ROOT
+    - the metrics are summed over all ranks: symbols stepped, nodes per state,
+      sessions finished and time blocked in MPI_Recv; ROOT compares them with what
+      it has sent, so the queue depth is how many of the symbols ROOT had sent by the
+      time the reduction completed the average node had not stepped over yet when
+      it took its snapshot
+    - a rank copies its metrics into a snapshot for each MPI_Ireduce and keeps
+      counting in its own copy, since the send buffer of a pending reduction must
+      not change
+    - the reductions run on their own communicator, so they never match symbols
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "mpi.h"
+#define _ROOT 0;                  // root node
+#define _NUM_ROUNDS 1000000;      // symbols ROOT sends to each node
+#define _METRICS_INTERVAL 10000;  // rounds between metrics
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  END =  4, // no more symbols
+};
+
+// enum states - Q
+#define NUM_STATES 4
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Metrics
+   ^^^^^^^
+   Every field is a double so that the whole struct reduces as one MPI_SUM over
+   METRICS_SIZE doubles.  ROOT takes part with zeros and keeps the number of symbols
+   it has sent to itself.
+*/
+
+struct metrics {
+  double stepped;             // symbols stepped over
+  double states[NUM_STATES];  // nodes in each state
+  double sessions;            // times the final state was reached
+  double stall;               // seconds blocked in MPI_Recv
+};
+#define METRICS_SIZE (int)(sizeof(struct metrics)/sizeof(double))
+
+const char *METRICS_HEADER = "time_s,round,symbols_sent,symbols_stepped,symbols_per_s,queue_depth,"
+                             "nodes_q0,nodes_q1,nodes_q2,nodes_q3,sessions,stall_mean_s\n";
+
+FILE *metrics_file;
+int metrics_fd = -1;
+long metrics_dropped;
+
+void metrics_open (const char *spec) {
+  struct sockaddr_un addr;
+  if (0 == strncmp(spec,"unix:",5)) {
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path,sizeof(addr.sun_path),"%s",spec+5);
+    metrics_fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if (metrics_fd < 0 || 0 != connect(metrics_fd,(struct sockaddr *)&addr,sizeof(addr))) {
+      perror(spec);
+      MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+    }
+    fcntl(metrics_fd,F_SETFL,fcntl(metrics_fd,F_GETFL) | O_NONBLOCK);
+  } else if (NULL == (metrics_file = fopen(spec,"w"))) {
+    perror(spec);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+}
+
+// never blocks on a socket: a line the collector has no room for is dropped whole
+void metrics_write (const char *line) {
+  size_t len = strlen(line);
+  if (NULL != metrics_file) {
+    fputs(line,metrics_file);
+    fflush(metrics_file);
+  } else if (len != (size_t)send(metrics_fd,line,len,MSG_DONTWAIT | MSG_NOSIGNAL)) {
+    ++metrics_dropped; // a partial line can only happen if the socket buffer is smaller than a line
+  }
+}
+
+void metrics_close (void) {
+  if (NULL != metrics_file)
+      fclose(metrics_file);
+  if (metrics_fd >= 0)
+      close(metrics_fd);
+}
+
+// ROOT turns a completed reduction into a line of the time series
+void metrics_sample (const struct metrics *sum, long round, double now, double sent, int num_nodes) {
+  static double last_time, last_stepped;
+  char line[512];
+  int workers = num_nodes-1;
+  double rate = (now > last_time) ? (sum->stepped - last_stepped)/(now - last_time) : 0.0;
+  snprintf(line,sizeof(line),"%.6f,%ld,%.0f,%.0f,%.1f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.6f\n",now,round,sent,
+           sum->stepped,rate,(sent - sum->stepped)/workers,sum->states[Q0],sum->states[Q1],sum->states[Q2],
+           sum->states[Q3],sum->sessions,sum->stall/workers);
+  metrics_write(line);
+  last_time = now;
+  last_stepped = sum->stepped;
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  long NUM_ROUNDS=_NUM_ROUNDS;
+  long METRICS_INTERVAL=_METRICS_INTERVAL;
+  int j,my_rank,num_nodes,my_state,pending=0,flag;
+  long round=0,pending_round=0,sent=0;
+  double t,start;
+  struct metrics mine, snapshot, sum; // snapshot is the send buffer of the pending reduction
+  MPI_Request req = MPI_REQUEST_NULL;
+  MPI_Comm data_comm, metrics_comm;
+  MPI_Status status;
+  const char *spec;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm);    // symbols
+  MPI_Comm_dup(MPI_COMM_WORLD,&metrics_comm); // the reductions
+
+  if (argc > 1)
+      NUM_ROUNDS = atol(argv[1]);
+  if (num_nodes < 2 || NUM_ROUNDS < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [rounds] [metrics output], with 2 or more ranks\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+  spec = (argc > 2) ? argv[2] : getenv("FSM_METRICS");
+  if (NULL == spec)
+      spec = "fsm-metrics.csv";
+
+  int msg = -1;
+  memset(&mine,0,sizeof(mine));
+  memset(&snapshot,0,sizeof(snapshot));
+  memset(&sum,0,sizeof(sum));
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  start = MPI_Wtime();
+  if (ROOT == my_rank) {
+    metrics_open(spec);
+    metrics_write(METRICS_HEADER);
+    my_state = R0;
+    while (round < NUM_ROUNDS) {
+      msg = get_random_msg();
+      for (j=1;j<num_nodes;j++)
+          MPI_Send(&msg,1,MPI_INT,j,0,data_comm); // blocking send, not ideal for efficiency
+      sent += num_nodes-1;
+      ++round;
+      // pick up the outstanding reduction if it has finished, wait only if the next one is due
+      if (pending) {
+        flag = 1;
+        if (0 == round % METRICS_INTERVAL)
+            MPI_Wait(&req,MPI_STATUS_IGNORE);
+        else
+            MPI_Test(&req,&flag,MPI_STATUS_IGNORE);
+        if (flag) {
+          metrics_sample(&sum,pending_round,MPI_Wtime()-start,sent,num_nodes);
+          pending = 0;
+        }
+      }
+      if (0 == round % METRICS_INTERVAL) {
+        snapshot = mine;
+        MPI_Ireduce(&snapshot,&sum,METRICS_SIZE,MPI_DOUBLE,MPI_SUM,ROOT,metrics_comm,&req);
+        pending = 1;
+        pending_round = round;
+      }
+    }
+    msg = END;
+    for (j=1;j<num_nodes;j++)
+        MPI_Send(&msg,1,MPI_INT,j,0,data_comm);
+    if (pending) {
+      MPI_Wait(&req,MPI_STATUS_IGNORE);
+      metrics_sample(&sum,pending_round,MPI_Wtime()-start,sent,num_nodes);
+    }
+  } else {
+    my_state = Q0;
+    while (END != msg) {
+      t = MPI_Wtime();
+      MPI_Recv(&msg,1,MPI_INT,ROOT,0,data_comm,&status);
+      mine.stall += MPI_Wtime() - t;
+      // react based on msg
+      switch (msg) {
+        case A:
+          if (Q0 == my_state)
+              my_state = next_state_proc(my_state,msg);
+          break;
+        case B:
+          if (Q1 == my_state)
+              my_state = next_state_proc(my_state,msg);
+          break;
+        case C:
+          if (Q2 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              ++mine.sessions;
+              my_state = Q0; // start the next session
+          }
+          break;
+        case END:
+          continue;
+      }
+      ++mine.stepped;
+      ++round;
+      if (pending) {
+        MPI_Test(&req,&flag,MPI_STATUS_IGNORE); // keeps the reduction moving
+        pending = !flag;
+      }
+      if (0 == round % METRICS_INTERVAL) {
+        if (pending)
+            MPI_Wait(&req,MPI_STATUS_IGNORE);
+        snapshot = mine;
+        memset(snapshot.states,0,sizeof(snapshot.states));
+        snapshot.states[my_state] = 1.0;
+        MPI_Ireduce(&snapshot,NULL,METRICS_SIZE,MPI_DOUBLE,MPI_SUM,ROOT,metrics_comm,&req);
+        pending = 1;
+      }
+    }
+    if (pending)
+        MPI_Wait(&req,MPI_STATUS_IGNORE);
+  }
+
+  // the last line covers the whole run
+  memset(mine.states,0,sizeof(mine.states));
+  if (ROOT != my_rank)
+      mine.states[my_state] = 1.0;
+  MPI_Reduce(&mine,&sum,METRICS_SIZE,MPI_DOUBLE,MPI_SUM,ROOT,metrics_comm);
+  if (ROOT == my_rank) {
+    metrics_sample(&sum,round,MPI_Wtime()-start,sent,num_nodes);
+    metrics_close();
+    printf("%ld rounds in %.3f s, %.0f sessions, metrics in %s",round,MPI_Wtime()-start,sum.sessions,spec);
+    if (metrics_dropped)
+        printf(" (%ld samples dropped)",metrics_dropped);
+    printf("\n");
+  }
+
+  MPI_Comm_free(&metrics_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,337 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 18 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to make two runs comparable.  In Example 3
+   rand() is never seeded, so the symbols depend on the C library, and how many
+   rounds ROOT sends before it notices an ACK depends on when MPI_Iprobe happens to
+   see it; timings of two runs measure two different workloads.  Here ROOT records
+   what it did in a compact log, and a replay does exactly the same again: the same
+   symbols, and every ACK taken in the same round and order as in the recording.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-18 record [log] [seed] [sessions per node]
+             mpi-fsm-18 replay [log]
+      the log defaults to fsm-replay.log, the seed to 1
+    - so that there is some load, a node that reaches its final state starts over
+      until it has finished the requested number of sessions, and only then ACKs
+    - record: ROOT seeds rand() and runs as in Example 9 (ACKs on ctrl_comm, drained
+      with MPI_Iprobe after every round, no more symbols for nodes that have ACKed),
+      then writes the log: the seed and sessions, 4 symbols per byte, and for every
+      ACK the round it was received in and its source
+    - replay: ROOT sends the recorded symbols and, at the end of each round, blocks
+      in MPI_Recv for exactly the ACKs that were received in that round, in the same
+      order; it never probes, so nothing depends on timing
+    - a node that has ACKed discards symbols until ROOT sends STOP, which ROOT does
+      as soon as it has the ACK, so that no symbol is ever left unreceived
+    - both modes print the elapsed time of the run, which can then be compared
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;                // root node
+#define _SEED 1;                // default seed of rand() when recording
+#define _NUM_SESSIONS 1000;     // times each node has to reach its final state
+#define CTRL_SIZE 2             // control messages are always {type, state of the sender}
+#define REPLAY_MAGIC "FSMREPL1"
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A    =  0,
+  B    =  1,
+  C    =  2,
+  ACK  =  3,
+  STOP =  4, // ROOT has the ACK, no more symbols will follow
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Replay log
+   ^^^^^^^^^^
+   A struct replay_header, then num_rounds symbols packed 4 to a byte (round r in
+   bits 2*(r%4) of byte r/4), then num_acks struct replay_ack in the order ROOT
+   received them.  ROOT keeps the whole log in memory while recording and writes it
+   at the end, so recording costs no I/O during the run.
+*/
+
+struct replay_header {
+  char magic[8];        // REPLAY_MAGIC
+  uint32_t seed;
+  int32_t num_nodes;
+  int64_t num_sessions;
+  int64_t num_rounds;
+  int64_t num_acks;
+};
+
+struct replay_ack {
+  int64_t round;        // received after the symbols of this round were sent
+  int32_t source;
+  int32_t state;        // as reported in the ACK
+};
+
+struct replay_log {
+  struct replay_header header;
+  uint8_t *symbols;
+  int64_t capacity;     // symbols there is room for
+  struct replay_ack *acks;
+};
+
+void replay_add_symbol (struct replay_log *log, int symbol) {
+  int64_t r = log->header.num_rounds++;
+  if (r == log->capacity) {
+    log->capacity = (log->capacity) ? 2*log->capacity : 4096;
+    log->symbols = realloc(log->symbols,log->capacity/4);
+    if (NULL == log->symbols) {
+      fprintf(stderr,"ROOT could not grow the replay log to %lld rounds\n",(long long)log->capacity);
+      MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+    }
+    memset(log->symbols+r/4,0,(log->capacity-r)/4);
+  }
+  log->symbols[r/4] |= (uint8_t)(symbol << 2*(r%4));
+}
+
+int replay_get_symbol (const struct replay_log *log, int64_t r) {
+  return (log->symbols[r/4] >> 2*(r%4)) & 3;
+}
+
+int replay_write (const struct replay_log *log, const char *path) {
+  FILE *out = fopen(path,"wb");
+  if (NULL == out)
+      return -1;
+  fwrite(&log->header,sizeof(log->header),1,out);
+  fwrite(log->symbols,1,(log->header.num_rounds+3)/4,out);
+  fwrite(log->acks,sizeof(struct replay_ack),log->header.num_acks,out);
+  return fclose(out);
+}
+
+int replay_read (struct replay_log *log, const char *path) {
+  FILE *in = fopen(path,"rb");
+  int ok = 0;
+  if (NULL == in)
+      return -1;
+  if (1 == fread(&log->header,sizeof(log->header),1,in) && 0 == memcmp(log->header.magic,REPLAY_MAGIC,8)
+      && log->header.num_rounds >= 0 && log->header.num_acks >= 0) {
+    log->capacity = (log->header.num_rounds+3)/4*4;
+    log->symbols = malloc(log->capacity/4 + 1);
+    log->acks = malloc(log->header.num_acks*sizeof(struct replay_ack) + 1);
+    ok = NULL != log->symbols && NULL != log->acks
+         && (size_t)(log->capacity/4) == fread(log->symbols,1,log->capacity/4,in)
+         && (size_t)log->header.num_acks == fread(log->acks,sizeof(struct replay_ack),log->header.num_acks,in);
+  }
+  fclose(in);
+  return (ok) ? 0 : -1;
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  unsigned SEED=_SEED;
+  long NUM_SESSIONS=_NUM_SESSIONS;
+  int j,source,my_rank,num_nodes,my_state,replay=0;
+  int64_t round,next_ack=0;
+  long sessions=0;
+  double start,elapsed;
+  const char *path = "fsm-replay.log";
+  struct replay_log log;
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols and STOP
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs
+
+  if (argc > 1 && 0 == strcmp(argv[1],"replay"))
+      replay = 1;
+  else if (argc > 1 && 0 != strcmp(argv[1],"record"))
+      replay = -1;
+  if (argc > 2)
+      path = argv[2];
+  if (argc > 3)
+      SEED = (unsigned)strtoul(argv[3],NULL,0);
+  if (argc > 4)
+      NUM_SESSIONS = atol(argv[4]);
+
+  // ROOT sets up the log, everybody learns whether it can go ahead
+  int ok = 1;
+  memset(&log,0,sizeof(log));
+  if (ROOT == my_rank) {
+    if (replay < 0 || num_nodes < 2) {
+      fprintf(stderr,"usage: %s record [log] [seed] [sessions per node] | replay [log], with 2 or more ranks\n",argv[0]);
+      ok = 0;
+    } else if (replay) {
+      if (0 != replay_read(&log,path)) {
+        fprintf(stderr,"%s: not a readable replay log\n",path);
+        ok = 0;
+      } else if (log.header.num_nodes != num_nodes) {
+        fprintf(stderr,"%s was recorded with %d ranks, not %d\n",path,log.header.num_nodes,num_nodes);
+        ok = 0;
+      }
+      NUM_SESSIONS = (long)log.header.num_sessions;
+    } else {
+      memcpy(log.header.magic,REPLAY_MAGIC,8);
+      log.header.seed = SEED;
+      log.header.num_nodes = num_nodes;
+      log.header.num_sessions = NUM_SESSIONS;
+      log.acks = malloc(num_nodes*sizeof(struct replay_ack));
+      srand(SEED);
+    }
+  }
+  MPI_Bcast(&ok,1,MPI_INT,ROOT,MPI_COMM_WORLD);
+  MPI_Bcast(&NUM_SESSIONS,1,MPI_LONG,ROOT,MPI_COMM_WORLD);
+  if (!ok || NUM_SESSIONS < 1) {
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  int msg = -1;
+  int ctrl[CTRL_SIZE];
+  int acked[num_nodes];
+    for (j=0;j<num_nodes;j++) acked[j] = 0;
+
+  int done = 0;
+  int flag = 0;
+  MPI_Barrier(MPI_COMM_WORLD);
+  start = MPI_Wtime();
+  if (ROOT == my_rank) {
+    my_state = R0;
+    for (round=0;!done;round++) {
+      if (replay) {
+        if (round == log.header.num_rounds) {
+          fprintf(stderr,"%s ends before every node has ACKed\n",path);
+          MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+        }
+        msg = replay_get_symbol(&log,round);
+      } else {
+        msg = get_random_msg();
+        replay_add_symbol(&log,msg);
+      }
+      // send msg to nodes that are still listening
+      for (j=1;j<num_nodes;j++)
+          if (!acked[j])
+              MPI_Send(&msg,1,MPI_INT,j,0,data_comm); // blocking send, not ideal for efficiency
+      // take this round's ACKs: whatever has arrived, or exactly what was recorded
+      do {
+        flag=0;
+        if (replay) {
+          if (next_ack < log.header.num_acks && round == log.acks[next_ack].round) {
+            MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,log.acks[next_ack++].source,0,ctrl_comm,&status);
+            flag = 1;
+          }
+        } else {
+          MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes that are done
+          if (1 == flag) {
+            MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,status.MPI_SOURCE,0,ctrl_comm,&status);
+            log.acks[log.header.num_acks].round = round;
+            log.acks[log.header.num_acks].source = status.MPI_SOURCE;
+            log.acks[log.header.num_acks++].state = ctrl[1];
+          }
+        }
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          acked[source] = 1;
+          msg = STOP;
+          MPI_Send(&msg,1,MPI_INT,source,0,data_comm);
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    }
+    elapsed = MPI_Wtime() - start;
+    if (!replay && 0 != replay_write(&log,path))
+        perror(path);
+    printf("%s %lld rounds, %lld ACKs, seed %u, %ld sessions per node: %.6f s\n",(replay) ? "replayed" : "recorded",
+           (long long)round,(long long)log.header.num_acks,log.header.seed,NUM_SESSIONS,elapsed);
+    free(log.symbols);
+    free(log.acks);
+  } else {
+    my_state = Q0;
+    while (STOP != msg) {
+      MPI_Recv(&msg,1,MPI_INT,ROOT,0,data_comm,&status);
+      if (done)
+          continue; // ACKed already, waiting for STOP
+      // react based on msg
+      switch (msg) {
+        case A:
+          if (Q0 == my_state)
+              my_state = next_state_proc(my_state,msg);
+          break;
+        case B:
+          if (Q1 == my_state)
+              my_state = next_state_proc(my_state,msg);
+          break;
+        case C:
+          if (Q2 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              if (NUM_SESSIONS == ++sessions) {
+                ctrl[0] = ACK;
+                ctrl[1] = my_state;
+                MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // blocking send, not ideal for efficiency
+                ++done;
+              } else {
+                my_state = Q0; // start the next session
+              }
+          }
+          break;
+      }
+    }
+  }
+
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
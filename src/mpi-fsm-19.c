@@ -0,0 +1,366 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 19 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to host many FSM instances per MPI rank.  One
+   rank per core, each with a single my_state, spends a whole MPI endpoint (and its
+   buffers) on a few bytes of state.  Here each non-root process is meant to run one
+   per node (or socket) and owns _NUM_INSTANCES FSM instances, stepped by a pool of
+   compute threads pinned to cores.  Only the main thread talks to MPI
+   (MPI_THREAD_FUNNELED): it receives batches of symbols and hands every symbol to
+   the thread that owns its instance through a lock-free single producer, single
+   consumer queue.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-19 [instances per node] [threads per node]
+    - ROOT sends batches of BATCH_SIZE {instance, RANDOM symbol} pairs to every
+      node that is still listening
+    - instance i of a node belongs to compute thread i % threads; each thread has one
+      struct spsc_queue, written only by the main thread and read only by its owner,
+      so C11 acquire/release on the two indexes is all the synchronization needed
+    - the ranks on a host that the launcher gave the same affinity mask share its
+      cores: each node takes its own THREADS of them in node-local rank order
+      (MPI_Comm_split_type), and compute thread t is pinned to the t-th; if there are
+      not enough to go around nothing is pinned, and the main thread never is
+    - an instance stays in its final state once it gets there; when all instances of
+      a node have, the main thread sends ROOT an ACK, and ROOT answers with a STOP
+      batch after which no more symbols follow
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "mpi.h"
+#define _ROOT 0;                // root node
+#define _NUM_INSTANCES 4096;    // FSM instances per node
+#define _NUM_THREADS 4;         // compute threads per node
+#define BATCH_SIZE 256          // {instance, symbol} pairs per batch
+#define BATCH_INTS (1+2*BATCH_SIZE)
+#define QUEUE_CAPACITY 4096     // entries per queue, a power of 2
+#define CTRL_SIZE 2             // control messages are always {type, state of the sender}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   SPSC queues
+   ^^^^^^^^^^^
+   head is only written by the consumer and tail only by the producer; each sits on
+   its own cache line so that the two threads do not fight over it.
+*/
+
+struct entry {
+  int instance;
+  int symbol;
+};
+
+struct spsc_queue {
+  _Alignas(64) atomic_size_t head;                 // next entry to read
+  _Alignas(64) atomic_size_t tail;                 // next entry to write
+  _Alignas(64) struct entry entries[QUEUE_CAPACITY];
+};
+
+int queue_push (struct spsc_queue *q, struct entry e) {
+  size_t tail = atomic_load_explicit(&q->tail,memory_order_relaxed);
+  if (tail - atomic_load_explicit(&q->head,memory_order_acquire) == QUEUE_CAPACITY)
+      return 0; // full
+  q->entries[tail & (QUEUE_CAPACITY-1)] = e;
+  atomic_store_explicit(&q->tail,tail+1,memory_order_release);
+  return 1;
+}
+
+int queue_pop (struct spsc_queue *q, struct entry *e) {
+  size_t head = atomic_load_explicit(&q->head,memory_order_relaxed);
+  if (head == atomic_load_explicit(&q->tail,memory_order_acquire))
+      return 0; // empty
+  *e = q->entries[head & (QUEUE_CAPACITY-1)];
+  atomic_store_explicit(&q->head,head+1,memory_order_release);
+  return 1;
+}
+
+/*
+   Compute threads
+   ^^^^^^^^^^^^^^^
+*/
+
+struct worker {
+  pthread_t thread;
+  int index;
+  int cpu;                      // core to pin to, or -1
+  int num_threads;
+  int *states;                  // of the instances this thread owns, by instance/num_threads
+  long stepped;
+  struct spsc_queue *queue;
+};
+
+atomic_int finished;            // instances of this node in their final state
+atomic_int stopping;            // no more entries will be pushed
+
+void *compute (void *arg) {
+  struct worker *w = arg;
+  struct entry e;
+  int *state;
+  if (w->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu,&set);
+    pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+  }
+  while (1) {
+    if (!queue_pop(w->queue,&e)) {
+      if (atomic_load_explicit(&stopping,memory_order_acquire) && !queue_pop(w->queue,&e))
+          break;
+      sched_yield();
+      continue;
+    }
+    state = &w->states[e.instance/w->num_threads];
+    ++w->stepped;
+    // react based on the symbol
+    switch (e.symbol) {
+      case A:
+        if (Q0 == *state)
+            *state = next_state_proc(*state,e.symbol);
+        break;
+      case B:
+        if (Q1 == *state)
+            *state = next_state_proc(*state,e.symbol);
+        break;
+      case C:
+        if (Q2 == *state) {
+            *state = next_state_proc(*state,e.symbol);
+            atomic_fetch_add_explicit(&finished,1,memory_order_relaxed);
+        }
+        break;
+    }
+  }
+  return NULL;
+}
+
+/*
+   Core selection
+   ^^^^^^^^^^^^^^
+   Collective over MPI_COMM_WORLD.  A rank that asks for no cores (ROOT) contributes an
+   empty mask, so it never takes a share.  Returns 0 if cores[] could not be filled.
+*/
+
+int pick_cores (int num_threads, int *cores) {
+  MPI_Comm node_comm;
+  cpu_set_t mine;
+  int i,c,node_rank,node_size,first,slot=0,count=0;
+  CPU_ZERO(&mine);
+  if (num_threads > 0 && 0 != sched_getaffinity(0,sizeof(mine),&mine))
+      CPU_ZERO(&mine);
+  MPI_Comm_split_type(MPI_COMM_WORLD,MPI_COMM_TYPE_SHARED,0,MPI_INFO_NULL,&node_comm);
+  MPI_Comm_rank(node_comm,&node_rank);
+  MPI_Comm_size(node_comm,&node_size);
+  cpu_set_t *masks = malloc(node_size*sizeof(cpu_set_t));
+  if (NULL == masks) {
+    fprintf(stderr,"could not allocate %d affinity masks\n",node_size);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  MPI_Allgather(&mine,sizeof(mine),MPI_BYTE,masks,sizeof(mine),MPI_BYTE,node_comm);
+  for (i=0;i<node_rank;i++)
+      if (CPU_EQUAL(&masks[i],&mine))
+          ++slot; // ranks before us on this host that share our cores
+  free(masks);
+  MPI_Comm_free(&node_comm);
+  if (0 == num_threads)
+      return 0;
+  // our share is the slot-th run of num_threads cores in the mask
+  first = slot*num_threads;
+  for (c=0;c<CPU_SETSIZE && count<first+num_threads;c++) {
+    if (!CPU_ISSET(c,&mine))
+        continue;
+    if (count >= first)
+        cores[count-first] = c;
+    ++count;
+  }
+  return first+num_threads == count;
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  int NUM_INSTANCES=_NUM_INSTANCES;
+  int NUM_THREADS=_NUM_THREADS;
+  int i,j,t,source,my_rank,num_nodes,provided,pinned;
+  long stepped=0,batches=0;
+  double start;
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff; only the main thread ever calls MPI
+  MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&provided);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // batches
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs
+
+  if (argc > 1)
+      NUM_INSTANCES = atoi(argv[1]);
+  if (argc > 2)
+      NUM_THREADS = atoi(argv[2]);
+  if (provided < MPI_THREAD_FUNNELED || NUM_INSTANCES < 1 || NUM_THREADS < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [instances per node] [threads per node], needs MPI_THREAD_FUNNELED (have %d)\n",
+                argv[0],provided);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  int cores[NUM_THREADS];
+  pinned = pick_cores((ROOT == my_rank) ? 0 : NUM_THREADS,cores);
+
+  int batch[BATCH_INTS];       // {count, instance, symbol, instance, symbol, ...}; count < 0 is STOP
+  int ctrl[CTRL_SIZE];
+  int acked[num_nodes];
+    for (j=0;j<num_nodes;j++) acked[j] = 0;
+
+  int done = 0;
+  int flag = 0;
+  MPI_Barrier(MPI_COMM_WORLD);
+  start = MPI_Wtime();
+  if (ROOT == my_rank) {
+    while (!done) {
+      // a fresh batch for every node that is still listening
+      for (j=1;j<num_nodes;j++) {
+        if (acked[j])
+            continue;
+        batch[0] = BATCH_SIZE;
+        for (i=0;i<BATCH_SIZE;i++) {
+          batch[1+2*i] = rand() % NUM_INSTANCES;
+          batch[2+2*i] = get_random_msg();
+        }
+        MPI_Send(batch,BATCH_INTS,MPI_INT,j,0,data_comm); // blocking send, not ideal for efficiency
+        ++batches;
+      }
+      // check for ACKs, only ever on the control channel
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes that are done
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,source,0,ctrl_comm,&status);
+          acked[source] = 1;
+          batch[0] = -1;
+          MPI_Send(batch,BATCH_INTS,MPI_INT,source,0,data_comm); // STOP
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    }
+    printf("ROOT sent %ld batches of %d symbols in %.6f s\n",batches,BATCH_SIZE,MPI_Wtime()-start);
+  } else {
+    struct worker *workers = calloc(NUM_THREADS,sizeof(struct worker));
+    if (NULL == workers) {
+      fprintf(stderr,"Node %d could not allocate %d instances\n",my_rank,NUM_INSTANCES);
+      MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+    }
+    for (t=0;t<NUM_THREADS;t++) {
+      workers[t].index = t;
+      workers[t].cpu = pinned ? cores[t] : -1;
+      workers[t].num_threads = NUM_THREADS;
+      workers[t].states = calloc(NUM_INSTANCES/NUM_THREADS+1,sizeof(int)); // every instance starts in Q0
+      workers[t].queue = aligned_alloc(64,sizeof(struct spsc_queue));
+      if (NULL == workers[t].states || NULL == workers[t].queue) {
+        fprintf(stderr,"Node %d could not set up thread %d\n",my_rank,t);
+        MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+      }
+      atomic_init(&workers[t].queue->head,0);
+      atomic_init(&workers[t].queue->tail,0);
+      pthread_create(&workers[t].thread,NULL,compute,&workers[t]);
+    }
+    while (1) {
+      MPI_Recv(batch,BATCH_INTS,MPI_INT,ROOT,0,data_comm,&status);
+      if (batch[0] < 0)
+          break; // STOP
+      if (done)
+          continue; // ACKed already, waiting for STOP
+      // hand every symbol to the thread that owns its instance
+      for (i=0;i<batch[0];i++) {
+        struct entry e = {batch[1+2*i],batch[2+2*i]};
+        struct spsc_queue *q = workers[e.instance % NUM_THREADS].queue;
+        while (!queue_push(q,e))
+            sched_yield(); // full, let the owner catch up
+      }
+      if (NUM_INSTANCES == atomic_load_explicit(&finished,memory_order_relaxed)) {
+        ctrl[0] = ACK;
+        ctrl[1] = Q3;
+        MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // blocking send, not ideal for efficiency
+        ++done;
+      }
+    }
+    atomic_store_explicit(&stopping,1,memory_order_release);
+    for (t=0;t<NUM_THREADS;t++) {
+      pthread_join(workers[t].thread,NULL);
+      stepped += workers[t].stepped;
+      free(workers[t].states);
+      free(workers[t].queue);
+    }
+    printf("Node %d: %d instances in FINAL state on %d threads (%s), %ld symbols stepped\n",my_rank,
+           atomic_load(&finished),NUM_THREADS,pinned ? "pinned" : "not pinned",stepped);
+    free(workers);
+  }
+
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
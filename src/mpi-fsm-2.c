@@ -75,7 +75,7 @@ int get_random_msg (void) {
 
 int main(int argc, char** argv) {
   int ROOT=_ROOT;
-  int i,j,k,source,my_rank,num_nodes,my_state;
+  int i,j,my_rank,num_nodes,my_state;
   MPI_Status status;
 
   // initialize mpi stuff
@@ -0,0 +1,331 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 20 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to route events to individual sessions rather
+   than broadcast every symbol to everyone.  Each event names a session by key, there
+   are far more sessions than ranks (millions by default), and every session is its
+   own FSM instance.  Sessions are hash partitioned over the non-producer ranks
+   (shards), and a shard keeps only a compact hash table from session key to state,
+   inserting a session in Q0 the first time one of its events arrives.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-20 [events per producer] [sessions] [producers]
+    - ranks 0 thru NUM_PRODUCERS-1 are producers (as in Example 8), every other rank
+      is a shard; session key k belongs to shard k % num_shards
+    - an event is a single uint64_t, key<<2|symbol; producers draw a RANDOM session and
+      a RANDOM symbol for each event
+    - producers never send single events: they fill one batch per destination shard
+      and MPI_Isend it once it holds BATCH_SIZE events; each destination has two
+      batches so one can be filled while the other is in flight
+    - a shard's table is open addressed (linear probing) with the keys in one array
+      and a uint8_t state per slot in another, grown to keep the load under 3/4
+    - a session stays in its final state once it gets there; later events for it are
+      still counted but change nothing
+    - when a producer is done it flushes its partial batches and sends every shard an
+      empty END message; a shard is done once it has END from all producers
+    - at the end an MPI_Gather brings every shard's counts to rank 0, which reports
+      them along with the totals
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "mpi.h"
+#define _ROOT 0;                // gathers the stats and reports them
+#define _NUM_PRODUCERS 1;       // ranks 0 thru _NUM_PRODUCERS-1 are producers
+#define _NUM_EVENTS 16000000;   // events generated by each producer
+#define _NUM_SESSIONS 1000000;  // distinct session keys
+#define BATCH_SIZE 4096         // events per batch
+#define TABLE_MIN_BITS 10       // a new table has 1<<TABLE_MIN_BITS slots
+#define DATA_TAG 0
+#define END_TAG 1
+#define NUM_STATS 5             // {events, sessions, finals, probes, table bytes}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+};
+
+// enum states - Q
+enum {
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for every session
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+/*
+   Random streams
+   ^^^^^^^^^^^^^^
+   splitmix64, as in Example 7; mix() is its finalizer on its own, used to turn a
+   session index into a key that looks like a real (scattered) session ID.
+*/
+
+uint64_t mix (uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+uint64_t next_random (uint64_t *stream) {
+  return mix(*stream += 0x9E3779B97F4A7C15ULL);
+}
+
+uint64_t session_key (uint64_t seed, uint64_t session) {
+  return mix(seed ^ session) >> 2; // 62 bits, leaving room for the symbol
+}
+
+/*
+   Session table
+   ^^^^^^^^^^^^^
+   keys[] holds key+1 so that 0 can mark an empty slot; states[] is parallel to it.
+   The slot is picked from the top bits of a multiplicative hash, since all the keys
+   of one shard agree modulo num_shards.
+*/
+
+struct table {
+  uint64_t *keys;
+  uint8_t *states;
+  int bits;
+  size_t size;
+  long probes;
+};
+
+size_t table_slot (const struct table *t, uint64_t key) {
+  return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - t->bits));
+}
+
+int table_init (struct table *t, int bits) {
+  t->bits = bits;
+  t->size = 0;
+  t->keys = calloc((size_t)1 << bits,sizeof(uint64_t));
+  t->states = calloc((size_t)1 << bits,sizeof(uint8_t));
+  return NULL != t->keys && NULL != t->states;
+}
+
+int table_grow (struct table *t) {
+  struct table bigger;
+  size_t i,j,capacity = (size_t)1 << t->bits;
+  if (!table_init(&bigger,t->bits+1))
+      return 0;
+  for (i=0;i<capacity;i++) {
+    if (0 == t->keys[i])
+        continue;
+    j = table_slot(&bigger,t->keys[i]-1);
+    while (0 != bigger.keys[j])
+        j = (j+1) & (((size_t)1 << bigger.bits)-1);
+    bigger.keys[j] = t->keys[i];
+    bigger.states[j] = t->states[i];
+  }
+  bigger.size = t->size;
+  bigger.probes = t->probes;
+  free(t->keys);
+  free(t->states);
+  *t = bigger;
+  return 1;
+}
+
+// returns the state of session key, inserting it in Q0 if it is new; NULL if out of memory
+uint8_t *table_lookup (struct table *t, uint64_t key) {
+  size_t mask,i;
+  if (4*(t->size+1) > 3*((size_t)1 << t->bits) && !table_grow(t))
+      return NULL;
+  mask = ((size_t)1 << t->bits)-1;
+  for (i=table_slot(t,key);0 != t->keys[i];i=(i+1) & mask) {
+    if (key+1 == t->keys[i])
+        return &t->states[i];
+    ++t->probes;
+  }
+  t->keys[i] = key+1;
+  t->states[i] = Q0;
+  ++t->size;
+  return &t->states[i];
+}
+
+// Main Program
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int NUM_PRODUCERS=_NUM_PRODUCERS;
+  long NUM_EVENTS=_NUM_EVENTS;
+  long NUM_SESSIONS=_NUM_SESSIONS;
+  int i,j,my_rank,num_nodes,num_shards,count,ends=0;
+  long n;
+  uint64_t seed,stream,key;
+  double start,elapsed;
+  MPI_Comm data_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc,&argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // batches and END
+
+  if (argc > 1)
+      NUM_EVENTS = atol(argv[1]);
+  if (argc > 2)
+      NUM_SESSIONS = atol(argv[2]);
+  if (argc > 3)
+      NUM_PRODUCERS = atoi(argv[3]);
+  num_shards = num_nodes - NUM_PRODUCERS;
+  if (NUM_EVENTS < 0 || NUM_SESSIONS < 1 || NUM_PRODUCERS < 1 || num_shards < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [events per producer] [sessions] [producers], needs more ranks than producers\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  // every producer has to agree on the session keys
+  seed = (uint64_t)time(NULL);
+  MPI_Bcast(&seed,1,MPI_UINT64_T,ROOT,MPI_COMM_WORLD);
+
+  long stats[NUM_STATS];
+    for (j=0;j<NUM_STATS;j++) stats[j] = 0;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  start = MPI_Wtime();
+  if (my_rank < NUM_PRODUCERS) {
+    // two batches per shard, [shard][slot]
+    uint64_t *out = malloc((size_t)num_shards*2*BATCH_SIZE*sizeof(uint64_t));
+    int *fill = calloc(num_shards,sizeof(int));
+    int *slot = calloc(num_shards,sizeof(int));
+    MPI_Request *reqs = malloc((size_t)num_shards*2*sizeof(MPI_Request));
+    if (NULL == out || NULL == fill || NULL == slot || NULL == reqs) {
+      fprintf(stderr,"Producer %d could not allocate batches for %d shards\n",my_rank,num_shards);
+      MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+    }
+    for (j=0;j<2*num_shards;j++) reqs[j] = MPI_REQUEST_NULL;
+    stream = seed;
+    stream = next_random(&stream) ^ (uint64_t)my_rank; // a stream of its own
+    for (n=0;n<NUM_EVENTS;n++) {
+      key = session_key(seed,next_random(&stream) % NUM_SESSIONS);
+      j = key % num_shards;
+      out[((size_t)j*2+slot[j])*BATCH_SIZE + fill[j]++] = key << 2 | next_random(&stream) % NUM_SYMBOLS;
+      if (BATCH_SIZE == fill[j]) {
+        MPI_Isend(&out[((size_t)j*2+slot[j])*BATCH_SIZE],BATCH_SIZE,MPI_UINT64_T,NUM_PRODUCERS+j,DATA_TAG,
+                  data_comm,&reqs[j*2+slot[j]]);
+        // fill the other batch next, once its last send is done
+        slot[j] ^= 1;
+        fill[j] = 0;
+        MPI_Wait(&reqs[j*2+slot[j]],MPI_STATUS_IGNORE);
+      }
+    }
+    for (j=0;j<num_shards;j++) {
+      if (fill[j] > 0)
+          MPI_Isend(&out[((size_t)j*2+slot[j])*BATCH_SIZE],fill[j],MPI_UINT64_T,NUM_PRODUCERS+j,DATA_TAG,
+                    data_comm,&reqs[j*2+slot[j]]);
+    }
+    MPI_Waitall(2*num_shards,reqs,MPI_STATUSES_IGNORE);
+    for (j=0;j<num_shards;j++)
+        MPI_Send(NULL,0,MPI_UINT64_T,NUM_PRODUCERS+j,END_TAG,data_comm);
+    free(reqs);
+    free(slot);
+    free(fill);
+    free(out);
+  } else {
+    struct table sessions;
+    uint64_t *batch = malloc(BATCH_SIZE*sizeof(uint64_t));
+    uint8_t *state;
+    int symbol;
+    if (NULL == batch || !table_init(&sessions,TABLE_MIN_BITS)) {
+      fprintf(stderr,"Shard %d could not allocate its session table\n",my_rank);
+      MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+    }
+    sessions.probes = 0;
+    while (ends < NUM_PRODUCERS) {
+      MPI_Recv(batch,BATCH_SIZE,MPI_UINT64_T,MPI_ANY_SOURCE,MPI_ANY_TAG,data_comm,&status);
+      if (END_TAG == status.MPI_TAG) {
+        ++ends;
+        continue;
+      }
+      MPI_Get_count(&status,MPI_UINT64_T,&count);
+      for (i=0;i<count;i++) {
+        symbol = batch[i] & 3;
+        if (NULL == (state = table_lookup(&sessions,batch[i] >> 2))) {
+          fprintf(stderr,"Shard %d could not grow its session table past %zu sessions\n",my_rank,sessions.size);
+          MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+        }
+        // react based on the symbol
+        switch (symbol) {
+          case A:
+            if (Q0 == *state)
+                *state = next_state_proc(*state,symbol);
+            break;
+          case B:
+            if (Q1 == *state)
+                *state = next_state_proc(*state,symbol);
+            break;
+          case C:
+            if (Q2 == *state) {
+                *state = next_state_proc(*state,symbol);
+                ++stats[2];
+            }
+            break;
+        }
+      }
+      stats[0] += count;
+    }
+    stats[1] = sessions.size;
+    stats[3] = sessions.probes;
+    stats[4] = ((long)1 << sessions.bits)*(sizeof(uint64_t)+sizeof(uint8_t));
+    free(sessions.keys);
+    free(sessions.states);
+    free(batch);
+  }
+  elapsed = MPI_Wtime()-start;
+  MPI_Reduce(ROOT == my_rank ? MPI_IN_PLACE : &elapsed,&elapsed,1,MPI_DOUBLE,MPI_MAX,ROOT,MPI_COMM_WORLD); // until the last shard is done
+
+  long all_stats[ROOT == my_rank ? num_nodes*NUM_STATS : 1];
+  MPI_Gather(stats,NUM_STATS,MPI_LONG,all_stats,NUM_STATS,MPI_LONG,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank) {
+    long total[NUM_STATS];
+    for (j=0;j<NUM_STATS;j++) total[j] = 0;
+    printf("%5s %12s %10s %10s %10s %12s\n","shard","events","sessions","final","probes/ev","table KiB");
+    for (i=NUM_PRODUCERS;i<num_nodes;i++) {
+      long *s = &all_stats[i*NUM_STATS];
+      printf("%5d %12ld %10ld %10ld %10.3f %12ld\n",i,s[0],s[1],s[2],s[0] ? (double)s[3]/s[0] : 0.0,s[4]/1024);
+      for (j=0;j<NUM_STATS;j++) total[j] += s[j];
+    }
+    printf("%5s %12ld %10ld %10ld %10.3f %12ld\n","total",total[0],total[1],total[2],
+           total[0] ? (double)total[3]/total[0] : 0.0,total[4]/1024);
+    printf("%d producers, %d shards: %ld events in %.6f s (%.0f events/s)\n",NUM_PRODUCERS,num_shards,
+           total[0],elapsed,total[0]/elapsed);
+  }
+
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
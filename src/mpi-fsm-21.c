@@ -0,0 +1,298 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 21 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to balance skewed work with work stealing.
+   Every rank starts with the same number of FSM instances, but the input streams of
+   the higher ranks are much less likely to hold the symbol an instance is waiting
+   for, so they need many more symbols to reach the final state.  Without help, the
+   time until every instance is final is that of the slowest rank.  Here a rank that
+   runs out of instances asks a RANDOM peer for some of its unfinished ones, and the
+   peer hands over half of what it has left, so the time is closer to the average.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-21 [instances per rank] [skew] [steal, 0 or 1]
+    - every rank, ROOT included, steps FSM instances; ROOT also hosts a counter of the
+      instances that are not final yet, in an MPI_Win
+    - an instance is a 16 byte struct instance: its state, where it came from, and
+      the splitmix64 state of its own input stream, so moving the struct moves all
+      of the symbols it has yet to consume
+    - an instance that started on rank r sees the symbol it is waiting for with
+      probability 1/(1 + skew*r/(num_nodes-1)), otherwise a RANDOM other symbol
+    - a rank steps one instance for up to SLICE symbols at a time, and checks for
+      steal requests between slices
+    - an idle rank first subtracts the instances it finished from the counter with
+      MPI_Fetch_and_op; if there is still work somewhere it sends a STEAL_REQ to a
+      RANDOM victim and waits for the STEAL_REPLY (possibly empty), answering other
+      thieves with empty replies while it waits
+    - once the counter reads 0 a rank joins an MPI_Ibarrier and keeps answering steal
+      requests until every rank has joined; a thief only joins after its reply has
+      arrived, so no request is left unanswered
+    - at the end an MPI_Gather brings every rank's counts and two times to ROOT: when
+      it first ran out of instances ("idle at"), which shows the imbalance, and when it
+      saw the counter reach 0 ("done at"), which is about the same for every rank
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "mpi.h"
+#define _ROOT 0;                // hosts the counter window and reports
+#define _NUM_INSTANCES 256;     // FSM instances each rank starts with
+#define _SKEW 20000;            // extra difficulty of the last rank's instances
+#define _STEAL 1;               // 0 turns stealing off, for comparison
+#define SLICE 4096              // symbols stepped per instance between checks for thieves
+#define MAX_STEAL 64            // instances per STEAL_REPLY
+#define STEAL_REQ 0             // tags on steal_comm
+#define STEAL_REPLY 1
+#define NUM_STATS 7             // {finished here, stolen, given away, steal requests, symbols, out of work in us, done in us}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+};
+
+// enum states - Q
+enum {
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for every instance
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+/*
+   Instances
+   ^^^^^^^^^
+   Sent as MPI_BYTE, which is fine as long as every rank runs the same binary.
+*/
+
+struct instance {
+  uint64_t stream;              // splitmix64 state of its input stream
+  uint32_t id;
+  uint16_t origin;              // rank it started on, sets its difficulty
+  uint8_t state;
+  uint8_t pad;
+};
+
+uint64_t next_random (uint64_t *stream) {
+  uint64_t z = (*stream += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// in Q0, Q1 and Q2 the symbol that moves an instance on is A, B and C respectively
+int get_random_msg (struct instance *in, uint64_t difficulty) {
+  uint64_t r = next_random(&in->stream);
+  if (0 == r % difficulty)
+      return in->state;
+  return (in->state + 1 + (r >> 32) % 2) % NUM_SYMBOLS; // one of the other two
+}
+
+// Main Program
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int NUM_INSTANCES=_NUM_INSTANCES;
+  long SKEW=_SKEW;
+  int STEAL=_STEAL;
+  int i,j,k,my_rank,num_nodes,victim,count,msg,flag;
+  long total,remaining,delta,finished=0;
+  unsigned int seed;
+  double start;
+  MPI_Comm steal_comm;
+  MPI_Win counter_win;
+  MPI_Request barrier = MPI_REQUEST_NULL;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc,&argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&steal_comm); // STEAL_REQ and STEAL_REPLY
+
+  if (argc > 1)
+      NUM_INSTANCES = atoi(argv[1]);
+  if (argc > 2)
+      SKEW = atol(argv[2]);
+  if (argc > 3)
+      STEAL = atoi(argv[3]);
+  if (NUM_INSTANCES < 1 || SKEW < 0 || num_nodes > UINT16_MAX) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [instances per rank] [skew] [steal, 0 or 1]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  // room for every instance there is, since any of them may end up here
+  total = (long)NUM_INSTANCES*num_nodes;
+  struct instance *work = malloc(total*sizeof(struct instance));
+  struct instance *reply = malloc(MAX_STEAL*sizeof(struct instance));
+  uint64_t difficulty[num_nodes];
+  long stats[NUM_STATS];
+  if (NULL == work || NULL == reply) {
+    fprintf(stderr,"Node %d could not allocate %ld instances\n",my_rank,total);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  for (j=0;j<num_nodes;j++)
+      difficulty[j] = 1 + (num_nodes > 1 ? SKEW*j/(num_nodes-1) : 0);
+  for (j=0;j<NUM_STATS;j++)
+      stats[j] = 0;
+  int count_local = NUM_INSTANCES;
+  for (i=0;i<NUM_INSTANCES;i++) {
+    work[i].stream = (uint64_t)my_rank*NUM_INSTANCES+i;
+    work[i].stream = next_random(&work[i].stream); // decorrelate neighbouring instances
+    work[i].id = my_rank*NUM_INSTANCES+i;
+    work[i].origin = my_rank;
+    work[i].state = Q0;
+    work[i].pad = 0;
+  }
+  seed = 1 + my_rank;
+
+  // the counter of unfinished instances lives on ROOT
+  long *counter = NULL;
+  MPI_Win_allocate((ROOT == my_rank) ? sizeof(long) : 0,sizeof(long),MPI_INFO_NULL,MPI_COMM_WORLD,&counter,&counter_win);
+  if (ROOT == my_rank)
+      *counter = total;
+  MPI_Barrier(MPI_COMM_WORLD); // counter is set before anyone subtracts from it
+  MPI_Win_lock_all(0,counter_win);
+
+  int done = 0;
+  int waiting = 0; // for a STEAL_REPLY
+  start = MPI_Wtime();
+  while (!done) {
+    // answer thieves, and pick up the reply to our own request
+    do {
+      flag = 0;
+      MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,steal_comm,&flag,&status);
+      if (1 == flag && STEAL_REQ == status.MPI_TAG) {
+        MPI_Recv(NULL,0,MPI_BYTE,status.MPI_SOURCE,STEAL_REQ,steal_comm,MPI_STATUS_IGNORE);
+        // give away half of what is left (never the last one), from the end of work[]
+        k = count_local/2;
+        if (k > MAX_STEAL)
+            k = MAX_STEAL;
+        count_local -= k;
+        stats[2] += k;
+        MPI_Send(&work[count_local],k*sizeof(struct instance),MPI_BYTE,status.MPI_SOURCE,STEAL_REPLY,steal_comm);
+      } else if (1 == flag && STEAL_REPLY == status.MPI_TAG) {
+        MPI_Recv(reply,MAX_STEAL*sizeof(struct instance),MPI_BYTE,status.MPI_SOURCE,STEAL_REPLY,steal_comm,&status);
+        MPI_Get_count(&status,MPI_BYTE,&count);
+        k = count/sizeof(struct instance);
+        for (i=0;i<k;i++)
+            work[count_local++] = reply[i];
+        stats[1] += k;
+        waiting = 0;
+      }
+    } while (1 == flag);
+
+    if (count_local > 0) {
+      // step the last instance for a slice; finished ones are dropped from work[]
+      struct instance *in = &work[count_local-1];
+      for (i=0;i<SLICE && Q3 != in->state;i++) {
+        msg = get_random_msg(in,difficulty[in->origin]);
+        // react based on msg
+        switch (msg) {
+          case A:
+            if (Q0 == in->state)
+                in->state = next_state_proc(in->state,msg);
+            break;
+          case B:
+            if (Q1 == in->state)
+                in->state = next_state_proc(in->state,msg);
+            break;
+          case C:
+            if (Q2 == in->state)
+                in->state = next_state_proc(in->state,msg);
+            break;
+        }
+      }
+      stats[4] += i;
+      if (Q3 == in->state) {
+        --count_local;
+        ++finished;
+        if (0 == count_local && 0 == stats[5])
+            stats[5] = (long)((MPI_Wtime()-start)*1e6); // the first time only
+      }
+    } else if (MPI_REQUEST_NULL != barrier) {
+      // nothing left anywhere, waiting for the others to notice
+      MPI_Test(&barrier,&done,MPI_STATUS_IGNORE);
+    } else if (!waiting) {
+      // idle: report what we finished and see whether there is anything left to steal
+      delta = -finished;
+      MPI_Fetch_and_op(&delta,&remaining,MPI_LONG,ROOT,0,MPI_SUM,counter_win);
+      MPI_Win_flush(ROOT,counter_win);
+      stats[0] += finished;
+      remaining -= finished;
+      finished = 0;
+      if (0 == remaining) {
+        MPI_Ibarrier(steal_comm,&barrier);
+        stats[6] = (long)((MPI_Wtime()-start)*1e6);
+      } else if (STEAL && num_nodes > 1) {
+        victim = rand_r(&seed) % (num_nodes-1);
+        if (victim >= my_rank)
+            ++victim; // anyone but us
+        MPI_Send(NULL,0,MPI_BYTE,victim,STEAL_REQ,steal_comm);
+        ++stats[3];
+        waiting = 1;
+      }
+    }
+  }
+
+  MPI_Win_unlock_all(counter_win);
+  MPI_Win_free(&counter_win);
+
+  long all_stats[(ROOT == my_rank) ? num_nodes*NUM_STATS : 1];
+  MPI_Gather(stats,NUM_STATS,MPI_LONG,all_stats,NUM_STATS,MPI_LONG,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank) {
+    long slowest = 0;
+    double mean = 0;
+    printf("%5s %10s %10s %10s %10s %10s %12s %12s %12s\n","rank","difficulty","finished","stolen","given",
+           "requests","symbols","idle at s","done at s");
+    for (i=0;i<num_nodes;i++) {
+      long *s = &all_stats[i*NUM_STATS];
+      printf("%5d %10lu %10ld %10ld %10ld %10ld %12ld %12.6f %12.6f\n",i,(unsigned long)difficulty[i],s[0],s[1],
+             s[2],s[3],s[4],s[5]/1e6,s[6]/1e6);
+      if (s[6] > slowest)
+          slowest = s[6];
+      mean += s[4];
+    }
+    printf("all %ld instances FINAL after %.6f s, stealing %s, %.0f symbols per rank on average\n",total,
+           slowest/1e6,STEAL ? "on" : "off",mean/num_nodes);
+  }
+
+  free(reply);
+  free(work);
+  MPI_Comm_free(&steal_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
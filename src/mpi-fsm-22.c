@@ -0,0 +1,287 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 22 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to let FSMs talk to each other.  Every
+   previous example only has the nodes consume symbols from ROOT, which cannot model
+   a pipeline or any other network of automata.  Here the FSM is a Mealy machine:
+   besides the next state, each (state, symbol) pair has an output action, OUT_PROC,
+   that emits a symbol to neighbouring ranks.  The network is an MPI distributed
+   graph topology, and the outputs are buffered per neighbour and exchanged once a
+   round with neighbourhood collectives.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-22 [chain|ring|tree] [instances per rank]
+    - the network is built with MPI_Dist_graph_create_adjacent (reorder=0, so ROOT
+      stays rank 0): chain is r->r+1, ring is r->(r+1)%num_nodes, tree is r->2r+1,2r+2
+    - every rank has NUM_INSTANCES instances; an output of instance i goes to
+      instance i on the neighbour, so each instance index is its own pipeline
+    - ROOT is the only rank with outside input: each round it steps every one of its
+      instances that is not final yet with a RANDOM symbol
+    - with the OUT_PROC table below, an instance passes on a symbol exactly when it
+      moves on, so downstream instances see A, B, C in order and also end up final
+    - a round is: step everything in the inbox, then MPI_Ineighbor_alltoall the
+      per-neighbour counts together with an MPI_Iallreduce of whether any rank is
+      still active, then MPI_Ineighbor_alltoallv the outputs themselves into the
+      inbox for the next round
+    - the run ends after a round in which ROOT injected nothing and nobody emitted
+      anything; an MPI_Gather then brings every rank's counts to ROOT
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi.h"
+#define _ROOT 0;                // only rank with outside input; reports
+#define _NUM_INSTANCES 1024;    // FSM instances per rank
+#define MAX_NEIGHBOURS 2        // out-degree of the largest network
+#define NUM_STATS 4             // {instances final, symbols stepped, symbols emitted, rounds}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+};
+
+// enum states - Q
+enum {
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+// network shapes
+enum {
+  CHAIN = 0,
+  RING  = 1,
+  TREE  = 2,
+  NUM_SHAPES
+};
+const char *SHAPES[NUM_SHAPES] = {"chain","ring","tree"};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+
+   The preconditions of the other examples are already in the matrix (every
+   symbol that a precondition rejects is a self loop), so step() uses it directly.
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+/*
+   Output functions - \lambda
+   ^^^^^^^^^^^^^^^^^^^^^^^^^^
+   For every (state, symbol), the symbol to emit and where to: the k-th out-neighbour
+   (modulo the out-degree), every out-neighbour (ALL), or nowhere (NONE).
+*/
+
+#define NONE -1
+#define ALL  -2
+
+struct output {
+  int symbol;
+  int to;
+};
+
+struct output OUT_PROC[4][NUM_SYMBOLS] = {{{A,ALL},{NONE,NONE},{NONE,NONE}},   // output function for all processes
+                                          {{NONE,NONE},{B,ALL},{NONE,NONE}},
+                                          {{NONE,NONE},{NONE,NONE},{C,ALL}},
+                                          {{NONE,NONE},{NONE,NONE},{NONE,NONE}}};
+
+/*
+   Outputs are {instance, symbol} pairs, kept in one buffer per out-neighbour.  An
+   instance emits at most 3 times in all (once per move), so 3*NUM_INSTANCES pairs
+   is enough for any neighbour in any round.
+*/
+
+struct outbox {
+  int outdegree;
+  int capacity;                 // pairs per neighbour
+  int counts[MAX_NEIGHBOURS];
+  int *pairs;                   // [neighbour][capacity][2]
+};
+
+void emit (struct outbox *out, int instance, struct output o) {
+  int k,first,last;
+  if (NONE == o.to || 0 == out->outdegree)
+      return;
+  first = (ALL == o.to) ? 0 : o.to % out->outdegree;
+  last = (ALL == o.to) ? out->outdegree-1 : first;
+  for (k=first;k<=last;k++) {
+    int *pair = &out->pairs[2*(k*out->capacity + out->counts[k]++)];
+    pair[0] = instance;
+    pair[1] = o.symbol;
+  }
+}
+
+// steps one instance and emits its output; returns 1 if it just became final
+int step (int *state, int instance, int symbol, struct outbox *out) {
+  struct output o = OUT_PROC[*state][symbol];
+  int was = *state;
+  *state = next_state_proc(*state,symbol);
+  emit(out,instance,o);
+  return Q3 != was && Q3 == *state;
+}
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+// Main Program
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int NUM_INSTANCES=_NUM_INSTANCES;
+  int shape=CHAIN;
+  int i,k,my_rank,num_nodes,indegree=0,active,any_active;
+  int sources[MAX_NEIGHBOURS],destinations[MAX_NEIGHBOURS],weights[MAX_NEIGHBOURS] = {1,1};
+  int sdispls[MAX_NEIGHBOURS],rdispls[MAX_NEIGHBOURS],recvcounts[MAX_NEIGHBOURS];
+  long stats[NUM_STATS] = {0,0,0,0};
+  struct outbox out;
+  MPI_Comm graph_comm;
+  MPI_Datatype pair_type;
+  MPI_Request reqs[2];
+
+  // initialize mpi stuff
+  MPI_Init(&argc,&argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+
+  if (argc > 1)
+      for (shape=NUM_SHAPES-1;shape>=0 && strcmp(argv[1],SHAPES[shape]);shape--);
+  if (argc > 2)
+      NUM_INSTANCES = atoi(argv[2]);
+  if (shape < 0 || NUM_INSTANCES < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [chain|ring|tree] [instances per rank]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  // the automaton network, as seen from this rank
+  out.outdegree = 0;
+  switch (shape) {
+    case CHAIN:
+      if (my_rank > 0)
+          sources[indegree++] = my_rank-1;
+      if (my_rank < num_nodes-1)
+          destinations[out.outdegree++] = my_rank+1;
+      break;
+    case RING:
+      sources[indegree++] = (my_rank+num_nodes-1) % num_nodes;
+      destinations[out.outdegree++] = (my_rank+1) % num_nodes;
+      break;
+    case TREE:
+      if (my_rank > 0)
+          sources[indegree++] = (my_rank-1)/2;
+      for (k=1;k<=2;k++)
+          if (2*my_rank+k < num_nodes)
+              destinations[out.outdegree++] = 2*my_rank+k;
+      break;
+  }
+  // all edges weigh the same; explicit weights rather than MPI_UNWEIGHTED, which trips gcc's -Wstringop-overread
+  MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,indegree,sources,weights,out.outdegree,destinations,
+                                 weights,MPI_INFO_NULL,0,&graph_comm);
+  MPI_Type_contiguous(2,MPI_INT,&pair_type);
+  MPI_Type_commit(&pair_type);
+
+  out.capacity = 3*NUM_INSTANCES;
+  out.pairs = malloc((size_t)MAX_NEIGHBOURS*out.capacity*2*sizeof(int));
+  int *inbox = malloc((size_t)MAX_NEIGHBOURS*out.capacity*2*sizeof(int));
+  int *states = calloc(NUM_INSTANCES,sizeof(int)); // every instance starts in Q0
+  if (NULL == out.pairs || NULL == inbox || NULL == states) {
+    fprintf(stderr,"Node %d could not allocate %d instances\n",my_rank,NUM_INSTANCES);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  for (k=0;k<MAX_NEIGHBOURS;k++) {
+    sdispls[k] = rdispls[k] = k*out.capacity;
+    recvcounts[k] = 0;
+  }
+
+  double start = MPI_Wtime();
+  while (1) {
+    for (k=0;k<out.outdegree;k++)
+        out.counts[k] = 0;
+    active = 0;
+    // outside input, ROOT only
+    if (ROOT == my_rank && stats[0] < NUM_INSTANCES) {
+      active = 1;
+      for (i=0;i<NUM_INSTANCES;i++) {
+        if (Q3 == states[i])
+            continue;
+        stats[0] += step(&states[i],i,get_random_msg(),&out);
+        ++stats[1];
+      }
+    }
+    // whatever the in-neighbours emitted last round
+    for (k=0;k<indegree;k++) {
+      for (i=0;i<recvcounts[k];i++) {
+        int *pair = &inbox[2*(rdispls[k]+i)];
+        stats[0] += step(&states[pair[0]],pair[0],pair[1],&out);
+        ++stats[1];
+      }
+    }
+    for (k=0;k<out.outdegree;k++) {
+      stats[2] += out.counts[k];
+      if (out.counts[k] > 0)
+          active = 1;
+    }
+    ++stats[3];
+    // counts to the neighbours, and whether anyone at all still has something going on
+    MPI_Ineighbor_alltoall(out.counts,1,MPI_INT,recvcounts,1,MPI_INT,graph_comm,&reqs[0]);
+    MPI_Iallreduce(&active,&any_active,1,MPI_INT,MPI_LOR,graph_comm,&reqs[1]);
+    MPI_Waitall(2,reqs,MPI_STATUSES_IGNORE);
+    if (!any_active)
+        break;
+    MPI_Ineighbor_alltoallv(out.pairs,out.counts,sdispls,pair_type,inbox,recvcounts,rdispls,pair_type,
+                            graph_comm,&reqs[0]);
+    MPI_Wait(&reqs[0],MPI_STATUS_IGNORE);
+  }
+  double elapsed = MPI_Wtime()-start;
+
+  long all_stats[(ROOT == my_rank) ? num_nodes*NUM_STATS : 1];
+  MPI_Gather(stats,NUM_STATS,MPI_LONG,all_stats,NUM_STATS,MPI_LONG,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank) {
+    long final = 0;
+    printf("%5s %10s %12s %12s\n","rank","final","stepped","emitted");
+    for (i=0;i<num_nodes;i++) {
+      long *s = &all_stats[i*NUM_STATS];
+      printf("%5d %10ld %12ld %12ld\n",i,s[0],s[1],s[2]);
+      final += s[0];
+    }
+    printf("%s network: %ld of %ld instances in FINAL state after %ld rounds, %.6f s\n",SHAPES[shape],
+           final,(long)NUM_INSTANCES*num_nodes,stats[3],elapsed);
+  }
+
+  free(states);
+  free(inbox);
+  free(out.pairs);
+  MPI_Type_free(&pair_type);
+  MPI_Comm_free(&graph_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
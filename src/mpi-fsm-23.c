@@ -0,0 +1,346 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 23 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to tell MPI which FSMs talk to each other, and
+   how much, so it can place them.  Sending to arbitrary ranks over MPI_COMM_WORLD
+   gives the library no locality hints.  Here the automaton interconnect (which FSM
+   sends to which, with a weight for how much) is turned into an MPI distributed graph
+   with reorder=1, so the library is free to give the processes new ranks that put
+   heavily communicating FSMs next to each other.  All FSM to FSM traffic then goes
+   through neighbourhood collectives on the graph, as in Example 22.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-23 [ring|torus|<interconnect file>] [instances per role] [reorder, 0 or 1]
+    - the FSMs are roles 0 thru num_nodes-1; a process's role is its MPI_COMM_WORLD
+      rank and stays that way however the graph renumbers it, so ROOT is role 0
+    - an interconnect is a list of directed edges "from to weight", weight 1 thru
+      MAX_WEIGHT; ring is r->r+1 with weight MAX_WEIGHT, torus is a 2D torus from
+      MPI_Dims_create with weight MAX_WEIGHT along rows and 1 along columns, and a file
+      has one edge per line ('#' starts a comment)
+    - every role has NUM_INSTANCES instances (lanes); lane i crosses an edge only if
+      i % MAX_WEIGHT < weight, so the weight given to MPI is the traffic on the edge
+    - the FSM is a Mealy machine: OUT_PROC gives the symbol an instance emits on each
+      (state, symbol), and it goes to the same lane on every out-neighbour that
+      carries it; ROOT feeds its lanes RANDOM symbols until they are all final
+    - the neighbour lists are kept in the order they were given to
+      MPI_Dist_graph_create_adjacent, which is the order the neighbourhood
+      collectives use, so reordering never changes who is who
+    - rounds, counts and termination are as in Example 22; at the end every
+      process's role, new rank, host and counts are gathered to ROOT
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi.h"
+#define _ROOT 0;                // role with outside input; reports
+#define _NUM_INSTANCES 1024;    // FSM instances (lanes) per role
+#define _REORDER 1;             // let MPI renumber the processes
+#define MAX_WEIGHT 8            // an edge of this weight carries every lane
+#define NUM_STATS 5             // {role, instances final, symbols stepped, symbols emitted, rounds}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+};
+
+// enum states - Q
+enum {
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all roles
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+/*
+   Output functions - \lambda
+   ^^^^^^^^^^^^^^^^^^^^^^^^^^
+   The symbol emitted on each (state, symbol), or NONE.
+*/
+
+#define NONE -1
+
+int OUT_PROC[4][NUM_SYMBOLS] = {{A,NONE,NONE},    // output function for all roles
+                                {NONE,B,NONE},
+                                {NONE,NONE,C},
+                                {NONE,NONE,NONE}};
+
+/*
+   Interconnect
+   ^^^^^^^^^^^^
+   Only the edges that touch this role are kept: ins[] are the sources, outs[] the
+   destinations, both as roles (which are MPI_COMM_WORLD ranks).
+*/
+
+struct neighbours {
+  int count;
+  int capacity;
+  int *roles;
+  int *weights;
+};
+
+void add_neighbour (struct neighbours *n, int role, int weight) {
+  if (n->count == n->capacity) {
+    n->capacity = n->capacity ? 2*n->capacity : 4;
+    n->roles = realloc(n->roles,n->capacity*sizeof(int));
+    n->weights = realloc(n->weights,n->capacity*sizeof(int));
+    if (NULL == n->roles || NULL == n->weights) {
+      fprintf(stderr,"could not allocate %d neighbours\n",n->capacity);
+      MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+    }
+  }
+  n->roles[n->count] = role;
+  n->weights[n->count++] = weight;
+}
+
+void add_edge (struct neighbours *ins, struct neighbours *outs, int my_role, int from, int to, int weight) {
+  if (from == my_role)
+      add_neighbour(outs,to,weight);
+  if (to == my_role)
+      add_neighbour(ins,from,weight);
+}
+
+// returns 0 if name is neither a generator nor a readable, well formed file
+int build_interconnect (const char *name, int my_role, int num_nodes, struct neighbours *ins,
+                        struct neighbours *outs) {
+  int r,dims[2] = {0,0};
+  if (!strcmp(name,"ring")) {
+    for (r=0;r<num_nodes;r++)
+        add_edge(ins,outs,my_role,r,(r+1) % num_nodes,MAX_WEIGHT);
+  } else if (!strcmp(name,"torus")) {
+    MPI_Dims_create(num_nodes,2,dims); // dims[0] rows of dims[1]
+    for (r=0;r<num_nodes;r++) {
+      int row = r / dims[1], col = r % dims[1];
+      add_edge(ins,outs,my_role,r,row*dims[1] + (col+1) % dims[1],MAX_WEIGHT);
+      add_edge(ins,outs,my_role,r,((row+1) % dims[0])*dims[1] + col,1);
+    }
+  } else {
+    char line[256];
+    int from,to,weight;
+    FILE *f = fopen(name,"r");
+    if (NULL == f)
+        return 0;
+    while (NULL != fgets(line,sizeof(line),f)) {
+      line[strcspn(line,"#")] = '\0';
+      if (strspn(line," \t\r\n") == strlen(line))
+          continue; // blank or comment
+      if (3 != sscanf(line,"%d %d %d",&from,&to,&weight) || from < 0 || from >= num_nodes || to < 0 ||
+          to >= num_nodes || weight < 1 || weight > MAX_WEIGHT) {
+        fclose(f);
+        return 0;
+      }
+      add_edge(ins,outs,my_role,from,to,weight);
+    }
+    fclose(f);
+  }
+  return 1;
+}
+
+/*
+   Outputs are {instance, symbol} pairs, one buffer per out-neighbour.  A lane moves
+   at most 3 times, so 3*NUM_INSTANCES pairs is enough for any neighbour in any round.
+*/
+
+struct outbox {
+  struct neighbours *outs;
+  int capacity;                 // pairs per neighbour
+  int *counts;
+  int *pairs;                   // [neighbour][capacity][2]
+};
+
+void emit (struct outbox *out, int instance, int symbol) {
+  int k;
+  if (NONE == symbol)
+      return;
+  for (k=0;k<out->outs->count;k++) {
+    if (instance % MAX_WEIGHT >= out->outs->weights[k])
+        continue; // this edge does not carry the lane
+    int *pair = &out->pairs[2*(k*out->capacity + out->counts[k]++)];
+    pair[0] = instance;
+    pair[1] = symbol;
+  }
+}
+
+// steps one instance and emits its output; returns 1 if it just became final
+int step (int *state, int instance, int symbol, struct outbox *out) {
+  int was = *state;
+  emit(out,instance,OUT_PROC[*state][symbol]);
+  *state = next_state_proc(*state,symbol);
+  return Q3 != was && Q3 == *state;
+}
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+// Main Program
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int NUM_INSTANCES=_NUM_INSTANCES;
+  int REORDER=_REORDER;
+  const char *interconnect = "torus";
+  int i,k,my_role,my_rank,graph_root,num_nodes,active,any_active,name_len;
+  long stats[NUM_STATS] = {0,0,0,0,0};
+  char host[MPI_MAX_PROCESSOR_NAME];
+  struct neighbours ins = {0,0,NULL,NULL}, outs = {0,0,NULL,NULL};
+  struct outbox out;
+  MPI_Comm graph_comm;
+  MPI_Group world_group,graph_group;
+  MPI_Datatype pair_type;
+  MPI_Request reqs[2];
+
+  // initialize mpi stuff
+  MPI_Init(&argc,&argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_role);
+
+  if (argc > 1)
+      interconnect = argv[1];
+  if (argc > 2)
+      NUM_INSTANCES = atoi(argv[2]);
+  if (argc > 3)
+      REORDER = atoi(argv[3]);
+  if (NUM_INSTANCES < 1 || !build_interconnect(interconnect,my_role,num_nodes,&ins,&outs)) {
+    if (ROOT == my_role)
+        fprintf(stderr,"usage: %s [ring|torus|<interconnect file>] [instances per role] [reorder, 0 or 1]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  // the weights are what the library places by; with reorder, my_rank may differ from my_role
+  MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,ins.count,ins.roles,ins.weights,outs.count,outs.roles,
+                                 outs.weights,MPI_INFO_NULL,REORDER,&graph_comm);
+  MPI_Comm_rank(graph_comm,&my_rank);
+  MPI_Comm_group(MPI_COMM_WORLD,&world_group);
+  MPI_Comm_group(graph_comm,&graph_group);
+  MPI_Group_translate_ranks(world_group,1,&ROOT,graph_group,&graph_root);
+  MPI_Group_free(&graph_group);
+  MPI_Group_free(&world_group);
+  MPI_Type_contiguous(2,MPI_INT,&pair_type);
+  MPI_Type_commit(&pair_type);
+
+  int degree = (ins.count > outs.count) ? ins.count : outs.count;
+  out.outs = &outs;
+  out.capacity = 3*NUM_INSTANCES;
+  out.counts = calloc(degree+1,sizeof(int));
+  out.pairs = malloc((size_t)(degree+1)*out.capacity*2*sizeof(int));
+  int *inbox = malloc((size_t)(degree+1)*out.capacity*2*sizeof(int));
+  int *recvcounts = calloc(degree+1,sizeof(int));
+  int *displs = malloc((degree+1)*sizeof(int));
+  int *states = calloc(NUM_INSTANCES,sizeof(int)); // every instance starts in Q0
+  if (NULL == out.counts || NULL == out.pairs || NULL == inbox || NULL == recvcounts || NULL == displs ||
+      NULL == states) {
+    fprintf(stderr,"Role %d could not allocate %d instances\n",my_role,NUM_INSTANCES);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  for (k=0;k<=degree;k++)
+      displs[k] = k*out.capacity;
+
+  stats[0] = my_role;
+  double start = MPI_Wtime();
+  while (1) {
+    for (k=0;k<outs.count;k++)
+        out.counts[k] = 0;
+    active = 0;
+    // outside input, ROOT only
+    if (ROOT == my_role && stats[1] < NUM_INSTANCES) {
+      active = 1;
+      for (i=0;i<NUM_INSTANCES;i++) {
+        if (Q3 == states[i])
+            continue;
+        stats[1] += step(&states[i],i,get_random_msg(),&out);
+        ++stats[2];
+      }
+    }
+    // whatever the in-neighbours emitted last round
+    for (k=0;k<ins.count;k++) {
+      for (i=0;i<recvcounts[k];i++) {
+        int *pair = &inbox[2*(displs[k]+i)];
+        stats[1] += step(&states[pair[0]],pair[0],pair[1],&out);
+        ++stats[2];
+      }
+    }
+    for (k=0;k<outs.count;k++) {
+      stats[3] += out.counts[k];
+      if (out.counts[k] > 0)
+          active = 1;
+    }
+    ++stats[4];
+    // counts to the neighbours, and whether anyone at all still has something going on
+    MPI_Ineighbor_alltoall(out.counts,1,MPI_INT,recvcounts,1,MPI_INT,graph_comm,&reqs[0]);
+    MPI_Iallreduce(&active,&any_active,1,MPI_INT,MPI_LOR,graph_comm,&reqs[1]);
+    MPI_Waitall(2,reqs,MPI_STATUSES_IGNORE);
+    if (!any_active)
+        break;
+    MPI_Ineighbor_alltoallv(out.pairs,out.counts,displs,pair_type,inbox,recvcounts,displs,pair_type,
+                            graph_comm,&reqs[0]);
+    MPI_Wait(&reqs[0],MPI_STATUS_IGNORE);
+  }
+  double elapsed = MPI_Wtime()-start;
+
+  // gathered in graph rank order, which is what shows where each role ended up
+  memset(host,0,sizeof(host));
+  MPI_Get_processor_name(host,&name_len);
+  long all_stats[(graph_root == my_rank) ? num_nodes*NUM_STATS : 1];
+  char all_hosts[(graph_root == my_rank) ? num_nodes*MPI_MAX_PROCESSOR_NAME : 1];
+  MPI_Gather(stats,NUM_STATS,MPI_LONG,all_stats,NUM_STATS,MPI_LONG,graph_root,graph_comm);
+  MPI_Gather(host,MPI_MAX_PROCESSOR_NAME,MPI_CHAR,all_hosts,MPI_MAX_PROCESSOR_NAME,MPI_CHAR,graph_root,graph_comm);
+  if (graph_root == my_rank) {
+    long final = 0;
+    printf("%5s %5s %-20s %10s %12s %12s\n","rank","role","host","final","stepped","emitted");
+    for (i=0;i<num_nodes;i++) {
+      long *s = &all_stats[i*NUM_STATS];
+      printf("%5d %5ld %-20.20s %10ld %12ld %12ld\n",i,s[0],&all_hosts[i*MPI_MAX_PROCESSOR_NAME],s[1],s[2],s[3]);
+      final += s[1];
+    }
+    printf("%s interconnect, reorder=%d: %ld of %ld instances in FINAL state after %ld rounds, %.6f s\n",interconnect,
+           REORDER,final,(long)NUM_INSTANCES*num_nodes,stats[4],elapsed);
+  }
+
+  free(states);
+  free(displs);
+  free(recvcounts);
+  free(inbox);
+  free(out.pairs);
+  free(out.counts);
+  free(outs.roles);
+  free(outs.weights);
+  free(ins.roles);
+  free(ins.weights);
+  MPI_Type_free(&pair_type);
+  MPI_Comm_free(&graph_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
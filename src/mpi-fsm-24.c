@@ -0,0 +1,373 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 24 Description
+   ^^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to detect termination when every process may
+   send to every other.  The ACK scheme of Example 3 works because ROOT is the only
+   source of symbols: once every node has ACKed, nothing else can be on its way.  Once
+   the FSMs message each other directly (and asynchronously), "every process is idle"
+   is not enough, since a message still in flight can wake one up again.  Here
+   termination is detected with Safra's algorithm: a single token makes waves around
+   the ring of processes, adding up how many messages each has sent minus received
+   and noting whether any of them received one since the token last passed.  It costs
+   num_nodes control messages per wave, however many symbols are exchanged.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - usage: mpi-fsm-24 [instances per rank]
+    - every rank has NUM_INSTANCES instances of a Mealy machine (as in Example 22):
+      when instance i moves on, it emits the symbol that moved it to instance i on
+      rank my_rank+1 and on rank my_rank+1+i%(num_nodes-1) (modulo num_nodes)
+    - ROOT is the only rank with outside input, a RANDOM symbol per unfinished
+      instance per round until all of them are final
+    - outputs are buffered per destination and sent with MPI_Isend in batches of up to
+      BATCH_SIZE pairs on data_comm; while waiting for a send buffer to free up a rank
+      keeps receiving into its inbox, so two ranks can never block each other
+    - a rank is passive when its inbox is empty, its output buffers are flushed and it
+      has no outside input left; only then does it pass the token on
+    - every rank counts messages sent minus received, and turns BLACK whenever it
+      receives one; the token {count, color} goes ROOT -> 1 -> ... -> num_nodes-1 ->
+      ROOT on ctrl_comm, each rank adding its count, blackening it if the rank is
+      BLACK, and turning WHITE itself
+    - when the token gets back to ROOT WHITE, ROOT is WHITE too and the count (with
+      ROOT's own) is 0, nothing is in flight and everyone is passive: ROOT sends
+      TERMINATE to every rank; otherwise ROOT starts another wave
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "mpi.h"
+#define _ROOT 0;                // only rank with outside input; initiates the waves
+#define _NUM_INSTANCES 1024;    // FSM instances per rank
+#define BATCH_SIZE 256          // {instance, symbol} pairs per data message
+#define SLICE 1024              // inbox pairs stepped between checks of the channels
+#define CTRL_SIZE 3             // control messages are always {type, count, color}
+#define NUM_STATS 6             // {instances final, symbols stepped, messages sent, messages received, tokens passed, waves}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A         =  0,
+  B         =  1,
+  C         =  2,
+  TOKEN     =  3,
+  TERMINATE =  4,
+};
+
+// enum states - Q
+enum {
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+// process and token colors
+enum {
+  WHITE = 0, // nothing received since the token last passed
+  BLACK = 1,
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+/*
+   Output functions - \lambda
+   ^^^^^^^^^^^^^^^^^^^^^^^^^^
+   The symbol emitted on each (state, symbol), or NONE.
+*/
+
+#define NONE -1
+
+int OUT_PROC[4][NUM_SYMBOLS] = {{A,NONE,NONE},    // output function for all processes
+                                {NONE,B,NONE},
+                                {NONE,NONE,C},
+                                {NONE,NONE,NONE}};
+
+/*
+   Channels
+   ^^^^^^^^
+   Everything a rank needs to know for Safra's algorithm lives in struct safra;
+   count and color are only changed where data messages are sent and received.
+*/
+
+struct safra {
+  long count;                   // data messages sent minus received
+  int color;
+  int has_token;
+  long token[CTRL_SIZE];        // the token while this rank holds it
+};
+
+struct inbox {
+  int *pairs;
+  long head,tail,capacity;      // in pairs
+};
+
+struct outbox {
+  int fill[2];                  // pairs in each of the two batches
+  int slot;                     // batch being filled
+  int pairs[2][2*BATCH_SIZE];
+  MPI_Request reqs[2];
+};
+
+struct channels {
+  MPI_Comm data_comm;
+  int num_nodes;
+  struct safra safra;
+  struct inbox inbox;
+  struct outbox *outboxes;      // one per destination rank
+  long stats[NUM_STATS];
+};
+
+// receives every data message that has arrived; nothing is stepped here
+void poll_inbox (struct channels *ch) {
+  int flag,count;
+  MPI_Status status;
+  struct inbox *in = &ch->inbox;
+  while (1) {
+    MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ch->data_comm,&flag,&status);
+    if (!flag)
+        return;
+    if (in->head == in->tail)
+        in->head = in->tail = 0;
+    if (in->tail + BATCH_SIZE > in->capacity) {
+      in->capacity = 2*in->capacity + BATCH_SIZE;
+      in->pairs = realloc(in->pairs,in->capacity*2*sizeof(int));
+      if (NULL == in->pairs) {
+        fprintf(stderr,"could not grow the inbox to %ld pairs\n",in->capacity);
+        MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+      }
+    }
+    MPI_Recv(&in->pairs[2*in->tail],2*BATCH_SIZE,MPI_INT,status.MPI_SOURCE,0,ch->data_comm,&status);
+    MPI_Get_count(&status,MPI_INT,&count);
+    in->tail += count/2;
+    --ch->safra.count;
+    ch->safra.color = BLACK;
+    ++ch->stats[3];
+  }
+}
+
+// sends the batch being filled for dest, then waits (receiving meanwhile) until the other one is free
+void flush (struct channels *ch, int dest) {
+  int flag = 0;
+  struct outbox *out = &ch->outboxes[dest];
+  if (0 == out->fill[out->slot])
+      return;
+  MPI_Isend(out->pairs[out->slot],2*out->fill[out->slot],MPI_INT,dest,0,ch->data_comm,&out->reqs[out->slot]);
+  ++ch->safra.count;
+  ++ch->stats[2];
+  out->slot ^= 1;
+  out->fill[out->slot] = 0;
+  while (1) {
+    MPI_Test(&out->reqs[out->slot],&flag,MPI_STATUS_IGNORE);
+    if (flag)
+        break;
+    poll_inbox(ch);
+  }
+}
+
+void emit (struct channels *ch, int dest, int instance, int symbol) {
+  struct outbox *out = &ch->outboxes[dest];
+  int *pair = &out->pairs[out->slot][2*out->fill[out->slot]++];
+  pair[0] = instance;
+  pair[1] = symbol;
+  if (BATCH_SIZE == out->fill[out->slot])
+      flush(ch,dest);
+}
+
+// steps one instance and emits its output; returns 1 if it just became final
+int step (struct channels *ch, int my_rank, int *state, int instance, int symbol) {
+  int was = *state;
+  int out = OUT_PROC[*state][symbol];
+  *state = next_state_proc(*state,symbol);
+  if (NONE != out && ch->num_nodes > 1) {
+    int next = (my_rank+1) % ch->num_nodes;
+    int other = (my_rank+1+instance % (ch->num_nodes-1)) % ch->num_nodes;
+    emit(ch,next,instance,out);
+    if (other != next)
+        emit(ch,other,instance,out);
+  }
+  return Q3 != was && Q3 == *state;
+}
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+// Main Program
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int NUM_INSTANCES=_NUM_INSTANCES;
+  int i,j,my_rank,num_nodes,flag;
+  struct channels ch;
+  long ctrl[CTRL_SIZE];
+  MPI_Comm ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc,&argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&ch.data_comm); // batches of outputs, counted by Safra
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm);    // TOKEN and TERMINATE, not counted
+
+  if (argc > 1)
+      NUM_INSTANCES = atoi(argv[1]);
+  if (NUM_INSTANCES < 1) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"usage: %s [instances per rank]\n",argv[0]);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  ch.num_nodes = num_nodes;
+  ch.safra.count = 0;
+  ch.safra.color = WHITE;
+  ch.safra.has_token = (ROOT == my_rank); // ROOT holds a BLACK token, so it starts the first wave
+  ch.safra.token[0] = TOKEN;
+  ch.safra.token[1] = 0;
+  ch.safra.token[2] = BLACK;
+  ch.inbox.pairs = NULL;
+  ch.inbox.head = ch.inbox.tail = ch.inbox.capacity = 0;
+  ch.outboxes = calloc(num_nodes,sizeof(struct outbox));
+  int *states = calloc(NUM_INSTANCES,sizeof(int)); // every instance starts in Q0
+  if (NULL == ch.outboxes || NULL == states) {
+    fprintf(stderr,"Node %d could not allocate %d instances\n",my_rank,NUM_INSTANCES);
+    MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  }
+  for (j=0;j<num_nodes;j++)
+      ch.outboxes[j].reqs[0] = ch.outboxes[j].reqs[1] = MPI_REQUEST_NULL;
+  for (j=0;j<NUM_STATS;j++)
+      ch.stats[j] = 0;
+
+  int done = 0;
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = MPI_Wtime();
+  while (!done) {
+    poll_inbox(&ch);
+    // TOKEN and TERMINATE, only ever on the control channel
+    MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status);
+    if (1 == flag) {
+      MPI_Recv(ctrl,CTRL_SIZE,MPI_LONG,status.MPI_SOURCE,0,ctrl_comm,&status);
+      if (TERMINATE == ctrl[0])
+          break;
+      ch.safra.has_token = 1;
+      for (j=0;j<CTRL_SIZE;j++)
+          ch.safra.token[j] = ctrl[j];
+    }
+
+    // outside input, ROOT only
+    if (ROOT == my_rank && ch.stats[0] < NUM_INSTANCES) {
+      for (i=0;i<NUM_INSTANCES;i++) {
+        if (Q3 == states[i])
+            continue;
+        ch.stats[0] += step(&ch,my_rank,&states[i],i,get_random_msg());
+        ++ch.stats[1];
+      }
+      continue;
+    }
+    // whatever the other ranks emitted
+    if (ch.inbox.head < ch.inbox.tail) {
+      for (i=0;i<SLICE && ch.inbox.head < ch.inbox.tail;i++) {
+        int instance = ch.inbox.pairs[2*ch.inbox.head];
+        int symbol = ch.inbox.pairs[2*ch.inbox.head+1];
+        ++ch.inbox.head;
+        ch.stats[0] += step(&ch,my_rank,&states[instance],instance,symbol);
+        ++ch.stats[1];
+      }
+      continue;
+    }
+    // nothing left to step: flush the partial batches, which may bring in more
+    for (j=0;j<num_nodes;j++)
+        flush(&ch,j);
+    if (ch.inbox.head < ch.inbox.tail || !ch.safra.has_token)
+        continue;
+
+    // passive, and holding the token
+    if (ROOT == my_rank) {
+      if (WHITE == ch.safra.token[2] && WHITE == ch.safra.color &&
+          0 == ch.safra.token[1] + ch.safra.count) {
+        ctrl[0] = TERMINATE;
+        ctrl[1] = ctrl[2] = 0;
+        for (j=0;j<num_nodes;j++)
+            if (j != my_rank)
+                MPI_Send(ctrl,CTRL_SIZE,MPI_LONG,j,0,ctrl_comm);
+        ++done;
+        continue;
+      }
+      // start a new wave
+      ++ch.stats[5];
+      ch.safra.color = WHITE;
+      ctrl[0] = TOKEN;
+      ctrl[1] = 0;
+      ctrl[2] = WHITE;
+      if (1 == num_nodes) {
+        ch.safra.token[1] = ctrl[1];
+        ch.safra.token[2] = ctrl[2];
+        continue; // the wave is already back
+      }
+    } else {
+      ctrl[0] = TOKEN;
+      ctrl[1] = ch.safra.token[1] + ch.safra.count;
+      ctrl[2] = (BLACK == ch.safra.color) ? BLACK : ch.safra.token[2];
+      ch.safra.color = WHITE;
+    }
+    MPI_Send(ctrl,CTRL_SIZE,MPI_LONG,(my_rank+1) % num_nodes,0,ctrl_comm);
+    ch.safra.has_token = 0;
+    ++ch.stats[4];
+  }
+  double elapsed = MPI_Wtime()-start;
+
+  for (j=0;j<num_nodes;j++)
+      MPI_Waitall(2,ch.outboxes[j].reqs,MPI_STATUSES_IGNORE); // all received, by now
+
+  long all_stats[(ROOT == my_rank) ? num_nodes*NUM_STATS : 1];
+  MPI_Gather(ch.stats,NUM_STATS,MPI_LONG,all_stats,NUM_STATS,MPI_LONG,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank) {
+    long final = 0, sent = 0, received = 0, tokens = 0;
+    printf("%5s %10s %12s %10s %10s %10s\n","rank","final","stepped","sent","received","tokens");
+    for (i=0;i<num_nodes;i++) {
+      long *s = &all_stats[i*NUM_STATS];
+      printf("%5d %10ld %12ld %10ld %10ld %10ld\n",i,s[0],s[1],s[2],s[3],s[4]);
+      final += s[0];
+      sent += s[2];
+      received += s[3];
+      tokens += s[4];
+    }
+    printf("%ld of %ld instances in FINAL state; %ld data messages sent, %ld received; termination detected "
+           "after %ld waves (%ld token messages) in %.6f s\n",final,(long)NUM_INSTANCES*num_nodes,sent,received,
+           ch.stats[5],tokens,elapsed);
+  }
+
+  free(ch.inbox.pairs);
+  free(ch.outboxes);
+  free(states);
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&ch.data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
@@ -84,7 +84,7 @@ int main(int argc, char** argv) {
   int ROOT=_ROOT;
   int ACK_COUNT=0;
   int MSG_SIZE = _MSG_SIZE;
-  int i,j,k,source,my_rank,num_nodes,my_state,tmpmsg;
+  int i,j,source,my_rank,num_nodes,my_state,tmpmsg;
   MPI_Status status;
 
   // initialize mpi stuff
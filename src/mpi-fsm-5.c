@@ -0,0 +1,174 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 5 Description
+   ^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to show a PULL based distribution of symbols.
+   In the previous examples ROOT pushes every symbol to every node, so all nodes are
+   forced to move at the speed of the slowest one and ROOT may have a send queued up
+   for every node at once.  Here each node asks for work when it is ready for it.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - each non-root process sends a READY request to ROOT that carries its current
+      state
+    - ROOT receives requests from MPI_ANY_SOURCE and answers the requesting node with
+      a batch of between 1 and _BATCH_SIZE RANDOM symbols
+    - the batch is tailored to the requesting node; if none of the random symbols
+      would satisfy the node's precondition, one of them is replaced by one that does
+    - because ROOT only ever sends in reply to a request, there is at most one batch
+      outstanding per node
+    - when each non-root process reaches its final state, it lets ROOT know
+      by sending an ACK message instead of a READY request
+    - when ROOT has received num_nodes-1 ACKs, it shuts down
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;        // root node
+#define _BATCH_SIZE 8;  // max number of symbols ROOT sends in reply to a single READY request
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A     =  0,
+  B     =  1,
+  C     =  2,
+  ACK   =  3,
+  READY =  4,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+// symbol that satisfies the precondition of a non-root process in the given state
+int EXPECT_PROC[4] = {A,B,C,-1};
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+// fills batch with 1 thru max RANDOM symbols for a node in the given state, returns the count
+int get_random_batch (int *batch, int max, int state) {
+  int i,count,useful=0;
+  count = 1 + rand() % max;
+  for (i=0;i<count;i++) {
+    batch[i] = get_random_msg();
+    if (EXPECT_PROC[state] == batch[i])
+        useful = 1;
+  }
+  if (!useful && 0 <= EXPECT_PROC[state]) // make sure the node can make progress
+      batch[rand() % count] = EXPECT_PROC[state];
+  return count;
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int BATCH_SIZE=_BATCH_SIZE;
+  int ACK_COUNT=0;
+  int i,count,source,my_rank,num_nodes,my_state;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+
+  int req[2];             // {READY|ACK, state of the requesting node}
+  int batch[BATCH_SIZE];
+  int done = 0;
+  if (ROOT == my_rank) {
+    my_state = R0;
+    while (!done) {
+      // wait for whichever node asks first
+      MPI_Recv(req,2,MPI_INT,MPI_ANY_SOURCE,0,MPI_COMM_WORLD,&status);
+      source = status.MPI_SOURCE;
+      if (ACK == req[0]) {
+        if (num_nodes-1 == ++ACK_COUNT)
+            ++done;
+        continue;
+      }
+      count = get_random_batch(batch,BATCH_SIZE,req[1]);
+      MPI_Send(batch,count,MPI_INT,source,0,MPI_COMM_WORLD); // only ever in reply, so never more than 1 per node in flight
+    }
+  } else {
+    my_state = Q0;
+    while (!done) {
+      req[0] = READY;
+      req[1] = my_state;
+      MPI_Send(req,2,MPI_INT,ROOT,0,MPI_COMM_WORLD);
+      MPI_Recv(batch,BATCH_SIZE,MPI_INT,ROOT,0,MPI_COMM_WORLD,&status);
+      MPI_Get_count(&status,MPI_INT,&count); // batches are variable sized
+      // react based on each msg in the batch
+      for (i=0;i<count && !done;i++) {
+        switch (batch[i]) {
+          case A:
+            if (Q0 == my_state) {
+                my_state = next_state_proc(my_state,batch[i]);
+                printf("Node %d now in state %d\n",my_rank,my_state);
+            }
+            break;
+          case B:
+            if (Q1 == my_state) {
+                my_state = next_state_proc(my_state,batch[i]);
+                printf("Node %d now in state %d\n",my_rank,my_state);
+            }
+            break;
+          case C:
+            if (Q2 == my_state) {
+                my_state = next_state_proc(my_state,batch[i]);
+                printf("Node %d now in FINAL state %d (shutting down...)\n",my_rank,my_state);
+                ++done;
+            }
+            break;
+        }
+      }
+    }
+    req[0] = ACK;
+    req[1] = my_state;
+    MPI_Send(req,2,MPI_INT,ROOT,0,MPI_COMM_WORLD); // blocking send, not ideal for efficiency
+  }
+
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
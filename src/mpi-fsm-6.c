@@ -0,0 +1,190 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 6 Description
+   ^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to show how to give each non-root process its
+   own, independent stream of symbols.  In the previous examples every node receives
+   the very same symbol, so every FSM walks through the same states and only one
+   useful simulation is really being run.  Here ROOT builds a DISTINCT batch for every
+   node and hands all of them out with a single MPI_Scatterv per round.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - each round, ROOT generates a RANDOM batch of symbols for each non-root process
+    - batches are variable sized; the size of a node's batch in a given round is
+      computed by get_batch_size(), which every process evaluates for itself so that
+      the receive counts are known without any extra communication
+    - the first element of each node's batch is a header that is either CONTINUE
+      or STOP, followed by the symbols
+    - when each non-root process reaches its final state, it lets ROOT know
+      by sending an ACK message; it keeps taking part in the (collective) rounds
+      and ignores the symbols it is given
+    - when ROOT has received num_nodes-1 ACKs, it sends STOP in the next round and
+      everyone shuts down
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;        // root node
+#define _BATCH_SIZE 8;  // max number of symbols a node receives in a single round
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A        =  0,
+  B        =  1,
+  C        =  2,
+  ACK      =  3,
+  CONTINUE =  4,
+  STOP     =  5,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+// number of symbols node gets in round; must give the same answer on every process
+int get_batch_size (int round, int node, int max) {
+  return 1 + (round * 31 + node * 17) % max; // returns 1 thru max
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int BATCH_SIZE=_BATCH_SIZE;
+  int ACK_COUNT=0;
+  int i,j,count,round,source,my_rank,num_nodes,my_state,tmpmsg;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+
+  int batch[1+BATCH_SIZE];       // header + symbols received by this node
+  int *sendbuf = NULL;           // ROOT only; every node's batch back to back
+  int *sendcounts = NULL;
+  int *displs = NULL;
+  if (ROOT == my_rank) {
+    sendbuf = malloc(num_nodes*(1+BATCH_SIZE)*sizeof(int));
+    sendcounts = malloc(num_nodes*sizeof(int));
+    displs = malloc(num_nodes*sizeof(int));
+    if (NULL == sendbuf || NULL == sendcounts || NULL == displs) {
+      fprintf(stderr,"Node %d could not allocate scatter buffers\n",my_rank);
+      MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+    }
+  }
+
+  int done = 0;
+  int flag = 0;
+  my_state = (ROOT == my_rank) ? R0 : Q0;
+  for (round=0;;round++) {
+    if (ROOT == my_rank) {
+      // build a distinct batch for each node
+      for (j=0;j<num_nodes;j++) {
+        displs[j] = j*(1+BATCH_SIZE);
+        if (ROOT == j) {
+          sendcounts[j] = 0; // ROOT keeps nothing for itself
+          continue;
+        }
+        sendcounts[j] = 1 + get_batch_size(round,j,BATCH_SIZE);
+        sendbuf[displs[j]] = (done) ? STOP : CONTINUE;
+        for (i=1;i<sendcounts[j];i++) sendbuf[displs[j]+i] = get_random_msg();
+      }
+      MPI_Scatterv(sendbuf,sendcounts,displs,MPI_INT,MPI_IN_PLACE,0,MPI_INT,ROOT,MPI_COMM_WORLD);
+      if (done)
+          break;
+      // check for ACKs
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,0,MPI_COMM_WORLD,&flag,&status); // a non-blocking check for ACK message from nodes in FINAL state
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(&tmpmsg,1,MPI_INT,source,0,MPI_COMM_WORLD,&status);
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    } else {
+      count = 1 + get_batch_size(round,my_rank,BATCH_SIZE);
+      MPI_Scatterv(NULL,NULL,NULL,MPI_INT,batch,count,MPI_INT,ROOT,MPI_COMM_WORLD);
+      if (STOP == batch[0])
+          break;
+      // react based on each msg in the batch
+      for (i=1;i<count && !done;i++) {
+        switch (batch[i]) {
+          case A:
+            if (Q0 == my_state) {
+                my_state = next_state_proc(my_state,batch[i]);
+                printf("Node %d now in state %d (round %d)\n",my_rank,my_state,round);
+            }
+            break;
+          case B:
+            if (Q1 == my_state) {
+                my_state = next_state_proc(my_state,batch[i]);
+                printf("Node %d now in state %d (round %d)\n",my_rank,my_state,round);
+            }
+            break;
+          case C:
+            if (Q2 == my_state) {
+                my_state = next_state_proc(my_state,batch[i]);
+                printf("Node %d now in FINAL state %d (round %d)\n",my_rank,my_state,round);
+                tmpmsg = ACK;
+                MPI_Send(&tmpmsg,1,MPI_INT,ROOT,0,MPI_COMM_WORLD); // blocking send, not ideal for efficiency
+                ++done;
+            }
+            break;
+        }
+      }
+    }
+  }
+
+  free(sendbuf);
+  free(sendcounts);
+  free(displs);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
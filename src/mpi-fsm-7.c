@@ -0,0 +1,175 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 7 Description
+   ^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to take ROOT out of the business of producing
+   symbols.  When ROOT calls get_random_msg() for every symbol, the total input rate of
+   the whole system is capped by what a single core can generate and send.  Here each
+   non-root process generates its own stream, and ROOT only handles control messages.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - ROOT picks a seed (argv[1], or the clock if none is given) and a stream base
+      (argv[2], or 0) and broadcasts them once at startup
+    - each non-root process seeds a private generator with the seed and the stream ID
+      (stream base + rank), so every node sees a different but reproducible stream;
+      running again with the same seed replays the exact same run
+    - each non-root process reacts to its own symbols exactly as in Example 3
+    - when each non-root process reaches its final state, it lets ROOT know
+      by sending an ACK message that carries the number of symbols it consumed
+    - when ROOT has received num_nodes-1 ACKs, it shuts down
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;    // root node
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+/*
+   Symbol streams
+   ^^^^^^^^^^^^^^
+   rand() has a single hidden state per process and its sequence is not specified
+   across C libraries, so it is no good for reproducible per-node streams.  Each
+   stream instead is a splitmix64 generator whose starting point is derived from
+   the seed and the stream ID.
+*/
+
+uint64_t next_random (uint64_t *stream) {
+  uint64_t z = (*stream += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void init_stream (uint64_t *stream, uint64_t seed, uint64_t id) {
+  *stream = seed;
+  *stream = next_random(stream) ^ id; // decorrelate neighbouring stream IDs
+  next_random(stream);
+}
+
+// Main Program
+
+int get_random_msg (uint64_t *stream) {
+  return next_random(stream) % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  int source,my_rank,num_nodes,my_state;
+  uint64_t setup[2];   // {seed, stream base}
+  uint64_t stream;
+  long consumed=0;     // symbols this node has taken from its stream
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+
+  // the only thing ROOT ever sends: the seed and stream base, once
+  if (ROOT == my_rank) {
+    setup[0] = (argc > 1) ? strtoull(argv[1],NULL,0) : (uint64_t)time(NULL);
+    setup[1] = (argc > 2) ? strtoull(argv[2],NULL,0) : 0;
+    printf("ROOT using seed %llu, stream base %llu\n",(unsigned long long)setup[0],(unsigned long long)setup[1]);
+  }
+  MPI_Bcast(setup,2,MPI_UINT64_T,ROOT,MPI_COMM_WORLD);
+
+  int msg = -1;
+  int done = 0;
+  if (ROOT == my_rank) {
+    my_state = R0;
+    while (!done) {
+      MPI_Recv(&consumed,1,MPI_LONG,MPI_ANY_SOURCE,ACK,MPI_COMM_WORLD,&status); // ROOT has nothing else to do, so block
+      source = status.MPI_SOURCE;
+      printf("ROOT got ACK from Node %d after %ld symbols\n",source,consumed);
+      if (num_nodes-1 == ++ACK_COUNT)
+          ++done;
+    }
+  } else {
+    my_state = Q0;
+    init_stream(&stream,setup[0],setup[1]+my_rank);
+    while (!done) {
+      msg = get_random_msg(&stream);
+      ++consumed;
+      // react based on msg
+      switch (msg) {
+        case A:
+          if (Q0 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              printf("Node %d now in state %d\n",my_rank,my_state);
+          }
+          break;
+        case B:
+          if (Q1 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              printf("Node %d now in state %d\n",my_rank,my_state);
+          }
+          break;
+        case C:
+          if (Q2 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              printf("Node %d now in FINAL state %d (shutting down...)\n",my_rank,my_state);
+              MPI_Send(&consumed,1,MPI_LONG,ROOT,ACK,MPI_COMM_WORLD); // blocking send, not ideal for efficiency
+              ++done;
+          }
+          break;
+      }
+    }
+  }
+
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
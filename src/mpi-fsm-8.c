@@ -0,0 +1,190 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 8 Description
+   ^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to show how to use more than one producer
+   (root) process.  With a single ROOT, that one process generates every symbol and
+   carries O(num_nodes) sends per symbol.  Here the first NUM_PRODUCERS ranks are all
+   producers, each owning its own partition of the consumer (non-root) processes and
+   its own stream of symbols.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - NUM_PRODUCERS defaults to _NUM_PRODUCERS (cut down to num_nodes-1 on smaller
+      runs) and may be given as argv[1]; ranks 0 thru NUM_PRODUCERS-1 are producers,
+      every other rank is a consumer
+    - consumers are dealt out to the producers round robin, and each producer and its
+      consumers get their own communicator from MPI_Comm_split, in which the producer
+      is local rank 0 (i.e., the local ROOT)
+    - within its partition, each producer behaves like ROOT in Example 3: it sends
+      RANDOM symbols (from its own seed) until all of its consumers have ACKed
+    - producers never talk to each other while running; at the very end a single
+      MPI_Reduce collects the number of consumers in their final state and the number
+      of symbols produced, and rank 0 reports the totals
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;            // local root node in each partition; also where the totals are reduced to
+#define _NUM_PRODUCERS 2;   // ranks 0 thru _NUM_PRODUCERS-1 are producers
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // each producer's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+// producer that owns the given consumer
+int get_producer (int rank, int num_producers) {
+  return (rank - num_producers) % num_producers;
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int NUM_PRODUCERS=_NUM_PRODUCERS;
+  int ACK_COUNT=0;
+  int j,source,my_rank,num_nodes,my_state,my_producer;
+  int my_local_rank,num_local_nodes;
+  int totals[2] = {0,0};   // {consumers in final state, symbols produced}
+  int sums[2];
+  MPI_Comm local_comm;     // a producer and the consumers it owns
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+
+  if (argc > 1)
+      NUM_PRODUCERS = atoi(argv[1]);
+  else if (NUM_PRODUCERS >= num_nodes && num_nodes > 1)
+      NUM_PRODUCERS = num_nodes-1; // only the default is cut down; an explicit count is taken as given
+  if (NUM_PRODUCERS < 1 || NUM_PRODUCERS >= num_nodes) {
+    if (ROOT == my_rank)
+        fprintf(stderr,"need 1 <= NUM_PRODUCERS < %d, got %d\n",num_nodes,NUM_PRODUCERS);
+    MPI_Finalize();
+    exit(EXIT_FAILURE);
+  }
+
+  // carve out one partition per producer; the producer gets key 0 so that it is the local ROOT
+  my_producer = (my_rank < NUM_PRODUCERS) ? my_rank : get_producer(my_rank,NUM_PRODUCERS);
+  MPI_Comm_split(MPI_COMM_WORLD,my_producer,(my_rank < NUM_PRODUCERS) ? 0 : my_rank,&local_comm);
+  MPI_Comm_size(local_comm,&num_local_nodes);
+  MPI_Comm_rank(local_comm,&my_local_rank);
+
+  int msg = -1;
+  int done = 0;
+  int flag = 0;
+  if (ROOT == my_local_rank) {
+    my_state = R0;
+    srand(1 + my_producer); // each producer has its own stream of symbols
+    done = (1 == num_local_nodes); // possible if there are more producers than consumers
+    while (!done) {
+      msg = get_random_msg();
+      ++totals[1];
+      // send msg to the nodes in this partition only
+      for (j=1;j<num_local_nodes;j++)
+          MPI_Send(&msg,1,MPI_INT,j,0,local_comm); // blocking send, not ideal for efficiency
+      // check for ACK
+      flag=0;
+      MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,local_comm,&flag,&status); // a non-blocking check for ACK message from nodes in FINAL state
+      if (1 == flag) {
+        source = status.MPI_SOURCE;
+        MPI_Recv(&msg,1,MPI_INT,source,0,local_comm,&status);
+        if (num_local_nodes-1 == ++ACK_COUNT)
+            ++done;
+      }
+    }
+  } else {
+    my_state = Q0;
+    while (!done) {
+      MPI_Recv(&msg,1,MPI_INT,ROOT,0,local_comm,&status);
+      // react based on msg
+      switch (msg) {
+        case A:
+          if (Q0 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              printf("Node %d (producer %d) now in state %d\n",my_rank,my_producer,my_state);
+          }
+          break;
+        case B:
+          if (Q1 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              printf("Node %d (producer %d) now in state %d\n",my_rank,my_producer,my_state);
+          }
+          break;
+        case C:
+          if (Q2 == my_state) {
+              my_state = next_state_proc(my_state,msg);
+              printf("Node %d (producer %d) now in FINAL state %d (shutting down...)\n",my_rank,my_producer,my_state);
+              msg = ACK;
+              MPI_Send(&msg,1,MPI_INT,ROOT,0,local_comm); // blocking send, not ideal for efficiency
+              ++totals[0];
+              ++done;
+          }
+          break;
+      }
+    }
+  }
+
+  // the one and only global synchronization
+  MPI_Reduce(totals,sums,2,MPI_INT,MPI_SUM,ROOT,MPI_COMM_WORLD);
+  if (ROOT == my_rank)
+      printf("%d producers: %d of %d nodes reached FINAL state, %d symbols produced\n",
+             NUM_PRODUCERS,sums[0],num_nodes-NUM_PRODUCERS,sums[1]);
+
+  MPI_Comm_free(&local_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}
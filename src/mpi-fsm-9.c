@@ -0,0 +1,167 @@
+/*
+   B. Estrade <estrabd@lsu.edu>
+
+   General Description
+   ^^^^^^^^^^^^^^^^^^^
+    - the root process sends some sequence of messages (symbols) to each process
+    - upon receipt of message, non-root processes will react to the message
+      based on the transition matrix and any preconditions
+    - each non-root process much receive at least 1 of each message;
+    - when a non-root process reaches the final state, it will shutdown;
+
+   Example 9 Description
+   ^^^^^^^^^^^^^^^^^^^^^
+   The main purpose of this example is to separate DATA traffic (symbols and their
+   payloads) from CONTROL traffic (ACKs and the like).  In Example 4 both share tag 0
+   on MPI_COMM_WORLD, the ACK is as big as a payload, and ROOT even receives it into
+   the very buffer it sends symbols from.  Here each kind of traffic gets its own
+   communicator and its own buffers.
+
+   In this example
+   ^^^^^^^^^^^^^^^
+    - data_comm and ctrl_comm are duplicates of MPI_COMM_WORLD; messages on one can
+      never be matched by (or queue up behind) messages on the other
+    - root sends RANDOM symbols, as arrays of _MSG_SIZE integers, on data_comm
+    - when each non-root process reaches its final state, it lets ROOT know
+      by sending a small ACK message of CTRL_SIZE integers on ctrl_comm
+    - ROOT only probes ctrl_comm, drains every ACK that is waiting, and stops sending
+      symbols to nodes that have already ACKed
+    - when ROOT has received num_nodes-1 ACKs, it shuts down
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mpi.h"
+#define _ROOT 0;        // root node
+#define _MSG_SIZE 100;  // msg is an array of _MSG_SIZE elements, taking up sizeof(int)*_MSG_SIZE bytes
+#define CTRL_SIZE 2     // control messages are always {type, state of the sender}
+
+// enumerate message types (i.e., symbols in the FSM's alphabet - \Sigma)
+#define NUM_SYMBOLS 3
+enum {
+  A   =  0,
+  B   =  1,
+  C   =  2,
+  ACK =  3,
+};
+
+// enum states - Q
+enum {
+  R0 = 0, // ROOT's one and only state in this example
+  Q0 = 0, // treated as the start state
+  Q1 = 1, // intermediate state
+  Q2 = 2, // intermediate state
+  Q3 = 3, // treated as a final state
+};
+
+/*
+   Transition functions - \delta
+   ^^^^^^^^^^^^^^^^^^^^
+   This transition matrix, taken with the symbols and states defined above
+   will be put into a final state, ST_FINAL, once it has seen at least one
+   of each message (symbol), in the order, A/B/C. The equivalent regular
+   expression would be: "(B|C)*A(A|C)*B(A|B)*C"
+*/
+
+int DELTA_PROC[4][NUM_SYMBOLS] = {{Q1,Q0,Q0},     // transition function for all non-root processes
+                                  {Q1,Q2,Q1},
+                                  {Q2,Q2,Q3},
+                                  {Q3,Q3,Q3}};
+int next_state_proc (int state, int symbol) {
+  return DELTA_PROC[state][symbol];
+}
+
+int DELTA_ROOT[1][NUM_SYMBOLS] = {{R0,R0,R0}};    // transition function for root process
+int next_state_root (int state, int symbol) {
+  return DELTA_ROOT[state][symbol];
+}
+
+// Main Program
+
+int get_random_msg (void) {
+  return rand() % NUM_SYMBOLS; // returns 0 thru NUM_SYMBOLS-1
+}
+
+int main(int argc, char** argv) {
+  int ROOT=_ROOT;
+  int ACK_COUNT=0;
+  int MSG_SIZE = _MSG_SIZE;
+  int i,j,source,my_rank,num_nodes,my_state,tmpmsg;
+  MPI_Comm data_comm, ctrl_comm;
+  MPI_Status status;
+
+  // initialize mpi stuff
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD,&num_nodes);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+  MPI_Comm_dup(MPI_COMM_WORLD,&data_comm); // symbols and their payloads
+  MPI_Comm_dup(MPI_COMM_WORLD,&ctrl_comm); // ACKs; never waits behind a payload
+
+  int msg[MSG_SIZE];
+    for (i=0;i<MSG_SIZE;i++) msg[i] = -1; //build msg
+  int ctrl[CTRL_SIZE];
+  int acked[num_nodes];
+    for (j=0;j<num_nodes;j++) acked[j] = 0;
+
+  int done = 0;
+  int flag = 0;
+  if (ROOT == my_rank) {
+    my_state = R0;
+    while (!done) {
+      tmpmsg = get_random_msg();
+        for (i=0;i<MSG_SIZE;i++) msg[i] = tmpmsg; //build msg
+      // send msg to nodes that are still listening
+      for (j=1;j<num_nodes;j++)
+          if (!acked[j])
+              MPI_Send(msg,MSG_SIZE,MPI_INT,j,0,data_comm); // blocking send, not ideal for efficiency
+      // check for ACKs, only ever on the control channel
+      do {
+        flag=0;
+        MPI_Iprobe(MPI_ANY_SOURCE,MPI_ANY_TAG,ctrl_comm,&flag,&status); // a non-blocking check for ACK message from nodes in FINAL state
+        if (1 == flag) {
+          source = status.MPI_SOURCE;
+          MPI_Recv(ctrl,CTRL_SIZE,MPI_INT,source,0,ctrl_comm,&status);
+          acked[source] = 1;
+          if (num_nodes-1 == ++ACK_COUNT)
+              ++done;
+        }
+      } while (1 == flag && !done);
+    }
+  } else {
+    my_state = Q0;
+    while (!done) {
+      MPI_Recv(msg,MSG_SIZE,MPI_INT,ROOT,0,data_comm,&status);
+      // react based on msg
+      switch (msg[0]) { // presumably, the first element of the msg array is the same as all other elements
+        case A:
+          if (Q0 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              printf("Node %d now in state %d\n",my_rank,my_state);
+          }
+          break;
+        case B:
+          if (Q1 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              printf("Node %d now in state %d\n",my_rank,my_state);
+          }
+          break;
+        case C:
+          if (Q2 == my_state) {
+              my_state = next_state_proc(my_state,msg[0]);
+              printf("Node %d now in FINAL state %d (shutting down...)\n",my_rank,my_state);
+              ctrl[0] = ACK;
+              ctrl[1] = my_state;
+              MPI_Send(ctrl,CTRL_SIZE,MPI_INT,ROOT,0,ctrl_comm); // blocking send, not ideal for efficiency
+              ++done;
+          }
+          break;
+      }
+    }
+  }
+
+  MPI_Comm_free(&ctrl_comm);
+  MPI_Comm_free(&data_comm);
+  MPI_Finalize();
+  exit(EXIT_SUCCESS);
+}